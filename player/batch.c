@@ -0,0 +1,109 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#include "batch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if PARALLEL
+#include <cilk/cilk.h>
+#endif
+
+#include "end_game.h"
+#include "eval.h"
+#include "move_gen.h"
+#include "tbassert.h"
+
+// Generates the moves of p into moves, returning how many there are.
+static int generate_one(position_t* p, move_t* moves) {
+  if (is_game_over(p)) {
+    return 0;
+  }
+  sortable_move_t lst[MAX_NUM_MOVES];
+  int num_moves = generate_all(p, lst);
+  tbassert(num_moves <= MAX_NUM_MOVES, "Too many moves: %d\n", num_moves);
+  for (int i = 0; i < num_moves; i++) {
+    moves[i] = get_move(lst[i]);
+  }
+  return num_moves;
+}
+
+// Makes the moves of p one after another on a scratch copy, taking each back
+// before the next, so that p itself is only read.
+static void make_one(position_t* p, const move_t* moves, int num_moves,
+                     position_t* children, int8_t* victim_counts) {
+  position_t scratch = *p;
+  repHistory_t reps;
+  rep_history_init(&scratch, &reps);
+  scratch.cold.history = NULL;
+
+  for (int j = 0; j < num_moves; j++) {
+    undo_t undo;
+    victims_t victims = make_move(&scratch, moves[j], &undo);
+    children[j] = scratch;
+    children[j].reps = NULL;
+    children[j].rep_top = 0;
+    children[j].cold.history = NULL;
+    if (victim_counts != NULL) {
+      victim_counts[j] = victims.count;
+    }
+    unmake_move(&scratch, &undo);
+  }
+}
+
+int batch_generate(position_t* ps, int n, move_t* moves, int* offsets) {
+  // Each position first writes its moves to a slot of MAX_NUM_MOVES, so that
+  // the positions are independent of one another ...
+  #ifdef PARALLEL
+    cilk_for (int i = 0; i < n; i++) {
+      offsets[i + 1] = generate_one(&ps[i], &moves[i * MAX_NUM_MOVES]);
+    }
+  #else
+    for (int i = 0; i < n; i++) {
+      offsets[i + 1] = generate_one(&ps[i], &moves[i * MAX_NUM_MOVES]);
+    }
+  #endif
+
+  // ... and the lists are then packed to the left in order.  A list never
+  // moves right, so none is overwritten before it has been moved.
+  offsets[0] = 0;
+  for (int i = 0; i < n; i++) {
+    int num_moves = offsets[i + 1];
+    offsets[i + 1] = offsets[i] + num_moves;
+    if (offsets[i] != i * MAX_NUM_MOVES) {
+      memmove(&moves[offsets[i]], &moves[i * MAX_NUM_MOVES],
+              num_moves * sizeof(move_t));
+    }
+  }
+  return offsets[n];
+}
+
+void batch_make_moves(position_t* ps, int n, const move_t* moves,
+                      const int* offsets, position_t* children,
+                      int8_t* victim_counts) {
+  #ifdef PARALLEL
+    cilk_for (int i = 0; i < n; i++) {
+      make_one(&ps[i], &moves[offsets[i]], offsets[i + 1] - offsets[i],
+               &children[offsets[i]],
+               victim_counts ? &victim_counts[offsets[i]] : NULL);
+    }
+  #else
+    for (int i = 0; i < n; i++) {
+      make_one(&ps[i], &moves[offsets[i]], offsets[i + 1] - offsets[i],
+               &children[offsets[i]],
+               victim_counts ? &victim_counts[offsets[i]] : NULL);
+    }
+  #endif
+}
+
+void batch_eval_features(position_t* ps, int n, int32_t* features) {
+  #ifdef PARALLEL
+    cilk_for (int i = 0; i < n; i++) {
+      eval_features(&ps[i], &features[i * NUM_HEURISTICS]);
+    }
+  #else
+    for (int i = 0; i < n; i++) {
+      eval_features(&ps[i], &features[i * NUM_HEURISTICS]);
+    }
+  #endif
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+
+#include "move_gen.h"
+
+// -----------------------------------------------------------------------------
+// Batch move generation
+// -----------------------------------------------------------------------------
+
+// Move generation and make-move over many positions at once, for tools that
+// need the children of thousands of positions (data generation, heuristic
+// comparisons) and would otherwise drive the engine one command at a time.
+// Positions are worked on in parallel in PARALLEL builds.
+//
+// Results are packed into caller-owned buffers.  The moves of ps[i] are
+// moves[offsets[i] .. offsets[i + 1]) and the child reached by moves[j] is
+// children[j], so one offsets array indexes both.
+//
+// The positions are boards only: their repetition history is not consulted,
+// and the children come back detached from any history (reps and
+// cold.history are NULL).  A child that should be searched or played on
+// needs rep_history_init() first.
+
+// Largest number of moves batch_generate() can write for n positions; the
+// moves buffer passed to it must have room for this many.
+#define BATCH_MOVES_CAPACITY(n) ((n) * MAX_NUM_MOVES)
+
+// Writes the moves of ps[0 .. n) to moves and their bounds to offsets, which
+// must have room for n + 1 entries.  A position whose game is over gets no
+// moves.  Returns the total number of moves, offsets[n].
+int batch_generate(position_t* ps, int n, move_t* moves, int* offsets);
+
+// Makes each move listed by batch_generate() on a copy of its position and
+// writes the result to children[j].  If victim_counts is not NULL,
+// victim_counts[j] receives the number of pieces moves[j] destroyed.  The
+// positions in ps are left unchanged.
+void batch_make_moves(position_t* ps, int n, const move_t* moves,
+                      const int* offsets, position_t* children,
+                      int8_t* victim_counts);
+
+// Writes eval_features() of ps[i] to features[i * NUM_HEURISTICS ..
+// (i + 1) * NUM_HEURISTICS), for turning many positions into tuning data at
+// once.
+void batch_eval_features(position_t* ps, int n, int32_t* features);
+
+// -----------------------------------------------------------------------------
+// Flat interface (batch_shim.c)
+// -----------------------------------------------------------------------------
+
+// The same operations through plain ints, chars and pointers only, for
+// callers outside C: scripts/lcbatch.py loads libleiserchess.so with ctypes
+// and calls these.  Position arrays are opaque to such callers; they are
+// allocated here because position_t is cache-line aligned.  lc_set_fen()
+// must not be called from more than one thread at a time.
+
+void lc_init();
+position_t* lc_alloc_positions(int n);
+void lc_free_positions(position_t* ps);
+position_t* lc_position_at(position_t* ps, int i);
+void lc_copy_position(position_t* dst, int i, position_t* src, int j);
+int lc_set_fen(position_t* ps, int i, const char* fen);
+int lc_get_fen(position_t* ps, int i, char* buf, int bufsize);
+int lc_is_game_over(position_t* ps, int i);
+int lc_max_moves();
+int lc_generate(position_t* ps, int n, uint16_t* moves, int* offsets);
+void lc_make_moves(position_t* ps, int n, const uint16_t* moves,
+                   const int* offsets, position_t* children,
+                   int8_t* victim_counts);
+int lc_move_to_str(uint16_t mv, char* buf, int bufsize);
+int lc_num_heuristics();
+void lc_eval_features(position_t* ps, int n, int32_t* features);
+
+#endif  // BATCH_H
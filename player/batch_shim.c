@@ -0,0 +1,88 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Flat interface to the batch API for ctypes; see the end of batch.h.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "end_game.h"
+#include "eval.h"
+#include "fen.h"
+#include "move_gen.h"
+
+_Static_assert(sizeof(move_t) == sizeof(uint16_t),
+               "lc_ functions pass moves as uint16_t");
+
+void lc_init() { init_zob(); }
+
+position_t* lc_alloc_positions(int n) {
+  position_t* ps;
+  if (n < 1) {
+    n = 1;
+  }
+  if (posix_memalign((void**)&ps, CACHE_LINE_SIZE, sizeof(position_t) * n) !=
+      0) {
+    return NULL;
+  }
+  return ps;
+}
+
+void lc_free_positions(position_t* ps) { free(ps); }
+
+position_t* lc_position_at(position_t* ps, int i) { return &ps[i]; }
+
+void lc_copy_position(position_t* dst, int i, position_t* src, int j) {
+  dst[i] = src[j];
+}
+
+// Sets ps[i] from fen, or to the starting position if fen is NULL.  Returns 0
+// on success.  The position is detached from the game history fen_to_pos()
+// keeps, like the children of batch_make_moves().
+int lc_set_fen(position_t* ps, int i, const char* fen) {
+  position_t* p = &ps[i];
+  if (fen_to_pos(p, fen != NULL ? fen : STARTPOS_FEN) != 0) {
+    return 1;
+  }
+  p->reps = NULL;
+  p->rep_top = 0;
+  p->cold.history = NULL;
+  return 0;
+}
+
+// Writes the FEN of ps[i] to buf.  Returns its length, or -1 if bufsize is too
+// small.
+int lc_get_fen(position_t* ps, int i, char* buf, int bufsize) {
+  char fen[MAX_FEN_CHARS + 1];
+  pos_to_fen(&ps[i], fen);
+  int len = snprintf(buf, bufsize, "%s", fen);
+  return len < bufsize ? len : -1;
+}
+
+int lc_is_game_over(position_t* ps, int i) { return is_game_over(&ps[i]); }
+
+int lc_max_moves() { return MAX_NUM_MOVES; }
+
+int lc_generate(position_t* ps, int n, uint16_t* moves, int* offsets) {
+  return batch_generate(ps, n, moves, offsets);
+}
+
+void lc_make_moves(position_t* ps, int n, const uint16_t* moves,
+                   const int* offsets, position_t* children,
+                   int8_t* victim_counts) {
+  batch_make_moves(ps, n, moves, offsets, children, victim_counts);
+}
+
+// Writes mv in the notation of the UCI interface to buf.  Returns its length.
+int lc_move_to_str(uint16_t mv, char* buf, int bufsize) {
+  move_to_str(mv, buf, bufsize);
+  return strlen(buf);
+}
+
+int lc_num_heuristics() { return NUM_HEURISTICS; }
+
+void lc_eval_features(position_t* ps, int n, int32_t* features) {
+  batch_eval_features(ps, n, features);
+}
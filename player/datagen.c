@@ -0,0 +1,306 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#include "datagen.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PARALLEL
+#include <cilk/cilk.h>
+#endif
+
+#include "dataset.h"
+#include "end_game.h"
+#include "fen.h"
+#include "move_gen.h"
+#include "search.h"
+#include "simple_mutex.h"
+#include "tt.h"
+#include "util.h"
+
+// Each game is played by one worker, start to finish, with searches of its
+// own: searchRoot() runs serially on the game's position, move list, killer
+// and history tables, as entry_point() runs it for one thread.  The games
+// share the transposition table, eval cache and Pawn hash, as the threads of
+// one search do, and append their records to the file when they end.
+//
+// Each game draws its random opening moves and its searches' root move orders
+// from a splitmix64() stream seeded from the seed and the game's number, so a
+// serial build plays the same games for the same seed.  Games played at once
+// still see each other's transposition table entries, so their searches, and
+// the records they write, depend on how the workers interleave.
+
+#define DEFAULT_DEPTH 4
+#define DEFAULT_RANDOM_PLIES 8
+
+// Deepest iteration of a search, leaving the search room below the root
+#define MAX_DEPTH (MAX_PLY_IN_SEARCH / 2)
+
+// Positions searched to a score this large, a win or loss in sight, are left
+// out, as are the ones whose best move zaps a piece (as training/datagen.py
+// does)
+#define MAX_RECORD_SCORE (30 * PAWN_VALUE)
+
+// Time given to a search, in milliseconds: some thousands of years
+#define NO_TIME_LIMIT 1e14
+
+// Games between progress reports
+#define PROGRESS_GAMES 100
+
+typedef struct {
+  int depth;             // deepest iteration of a search
+  uint64_t nodes;        // no iteration starts past this many nodes; 0: none
+  int random_plies;      // moves played at random to open each game
+  uint64_t seed;         // of the games' random choices
+} datagenConfig_t;
+
+// What the games share
+typedef struct {
+  FILE* f;
+  FILE* info;  // searchRoot()'s info lines, which nobody reads
+  simple_mutex_t mutex;  // guards everything below
+  bool failed;
+  uint64_t games;
+  uint64_t positions;
+  uint64_t nodes;
+  double start;  // milliseconds
+} datagenOutput_t;
+
+// Everything a game changes, so that games can be played at once
+typedef struct {
+  position_t p;
+  repHistory_t reps;
+  undo_t undo[MAX_PLY_IN_GAME];  // undo[i] records the i-th move of the game
+  bestMove pv[MAX_PLY_IN_SEARCH];
+  sortable_move_t move_list[MAX_NUM_MOVES];
+  int num_moves;
+  move_t killer __KMT_dim__;
+  int best_move_history __BMH_dim__;
+  dataRecord_t records[MAX_PLY_IN_GAME];
+  int num_records;
+  uint64_t nodes;
+  uint64_t rng;  // splitmix64() state of the game's random choices
+} game_t;
+
+// Plays a move chosen uniformly among the legal ones, recording it in u.
+// Returns false if there is none.
+static bool play_random_move(position_t* p, undo_t* u, uint64_t* rng) {
+  sortable_move_t moves[MAX_NUM_MOVES];
+  int n = generate_all(p, moves);
+  while (n > 0) {
+    int i = splitmix64(rng) % n;
+    move_t mv = get_move(moves[i]);
+    bool legal = !is_ILLEGAL(make_move(p, mv, u));
+    unmake_move(p, u);
+    if (legal) {
+      actually_make_move(p, mv, u);
+      return true;
+    }
+    moves[i] = moves[--n];
+  }
+  return false;
+}
+
+// Searches the game's position by iterative deepening, as entry_point() does,
+// until cfg->depth or cfg->nodes.  Returns the best move, or NULL_MOVE if
+// there is none, and its score for the side to move in *score.
+static move_t search_move(game_t* g, const datagenConfig_t* cfg, FILE* info,
+                          score_t* score) {
+  for (int i = 0; i < MAX_PLY_IN_SEARCH; i++) {
+    g->pv[i].score = -INF;
+    g->pv[i].move = NULL_MOVE;
+    g->pv[i].has_been_set = false;
+    g->pv[i].mutex = 0;
+  }
+
+  uint64_t nodes = 0;
+  move_t best = NULL_MOVE;
+  for (int d = 1; d <= cfg->depth; d++) {
+    searchRoot(&g->p, -INF, INF, d, 0, g->pv, &nodes, info, 0, g->move_list,
+               &g->num_moves, g->killer, g->best_move_history, &g->rng);
+    if (g->pv[d].has_been_set) {
+      best = g->pv[d].move;
+      *score = g->pv[d].score;
+    }
+    if (cfg->nodes != 0 && nodes >= cfg->nodes) {
+      break;
+    }
+  }
+  g->nodes += nodes;
+  return best;
+}
+
+static void report(const datagenOutput_t* out) {
+  double secs = (milliseconds() - out->start) / 1000;
+  if (secs < 0.001) {
+    secs = 0.001;
+  }
+  fprintf(stderr,
+          "info datagen games %" PRIu64 " positions %" PRIu64 " nodes %" PRIu64
+          " time %.1f positions/sec %.0f\n",
+          out->games, out->positions, out->nodes, secs,
+          out->positions / secs);
+}
+
+// Plays game number index from start and appends its records to out
+static void play_game(game_t* g, const position_t* start, uint64_t index,
+                      const datagenConfig_t* cfg, datagenOutput_t* out) {
+  position_t* p = &g->p;
+  *p = *start;
+  rep_history_init(p, &g->reps);
+  memset(g->killer, 0, sizeof(g->killer));
+  memset(g->best_move_history, 0, sizeof(g->best_move_history));
+  g->num_records = 0;
+  g->nodes = 0;
+  g->rng = cfg->seed + index * 0x9E3779B97F4A7C15ULL;
+
+  gameResult_t result = DRAWN;
+  int played = 0;
+  while (true) {
+    if (is_game_over(p)) {
+      result = player_wins(p, WHITE) ? WHITE_WON : BLACK_WON;
+      break;
+    }
+    if (is_draw(p) || played == MAX_PLY_IN_GAME) {
+      break;
+    }
+
+    if (played < cfg->random_plies) {
+      if (!play_random_move(p, &g->undo[played], &g->rng)) {
+        break;
+      }
+      played++;
+      continue;
+    }
+
+    score_t score = 0;
+    move_t mv = search_move(g, cfg, out->info, &score);
+    if (move_eq(mv, NULL_MOVE)) {
+      break;
+    }
+    dataRecord_t* r = &g->records[g->num_records];
+    pos_to_record(p, r);
+    r->score = color_to_move_of(p) == WHITE ? score : -score;
+    victims_t victims = actually_make_move(p, mv, &g->undo[played++]);
+    if (victims.count == 0 && abs(score) < MAX_RECORD_SCORE) {
+      g->num_records++;
+    }
+  }
+
+  for (int i = 0; i < g->num_records; i++) {
+    g->records[i].result = result;
+  }
+
+  simple_acquire(&out->mutex);
+  if (dataset_write(out->f, g->records, g->num_records) != 0) {
+    out->failed = true;
+  }
+  out->games++;
+  out->positions += g->num_records;
+  out->nodes += g->nodes;
+  // as each search of a UCI game does, so older games' entries give way
+  tt_age_hashtable();
+  if (out->games % PROGRESS_GAMES == 0) {
+    report(out);
+  }
+  simple_release(&out->mutex);
+}
+
+static void run_game(const position_t* start, uint64_t index,
+                     const datagenConfig_t* cfg, datagenOutput_t* out) {
+  // position_t is cache-line aligned, which malloc() does not guarantee
+  game_t* g;
+  if (posix_memalign((void**)&g, CACHE_LINE_SIZE, sizeof(game_t)) != 0) {
+    simple_acquire(&out->mutex);
+    out->failed = true;
+    simple_release(&out->mutex);
+    return;
+  }
+  play_game(g, start, index, cfg, out);
+  free(g);
+}
+
+static int usage() {
+  fprintf(stderr,
+          "Usage: leiserchess datagen <dataset> <games> [depth <d>] "
+          "[nodes <n>] [random <plies>] [seed <s>]\n");
+  return 1;
+}
+
+int datagen_main(int argc, char* argv[]) {
+  if (argc < 2 || argc % 2 != 0) {
+    return usage();
+  }
+  uint64_t games = strtoull(argv[1], NULL, 10);
+
+  datagenConfig_t cfg = {0, 0, DEFAULT_RANDOM_PLIES, 0};
+  for (int i = 2; i < argc; i += 2) {
+    if (strcmp(argv[i], "depth") == 0) {
+      cfg.depth = atoi(argv[i + 1]);
+      if (cfg.depth < 1 || cfg.depth > MAX_DEPTH) {
+        fprintf(stderr, "depth must be between 1 and %d\n", MAX_DEPTH);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "nodes") == 0) {
+      cfg.nodes = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "random") == 0) {
+      cfg.random_plies = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "seed") == 0) {
+      cfg.seed = strtoull(argv[i + 1], NULL, 10);
+    } else {
+      return usage();
+    }
+  }
+  // a node limit alone lets the search go as deep as the nodes take it
+  if (cfg.depth == 0) {
+    cfg.depth = cfg.nodes != 0 ? MAX_DEPTH : DEFAULT_DEPTH;
+  }
+
+  // fen_to_pos() is not for use by more than one thread, so the games copy
+  // this one
+  position_t* start;
+  if (posix_memalign((void**)&start, CACHE_LINE_SIZE, sizeof(position_t)) !=
+      0 || fen_to_pos(start, STARTPOS_FEN) != 0) {
+    return 1;
+  }
+
+  datagenOutput_t out;
+  memset(&out, 0, sizeof(out));
+  out.f = dataset_create(argv[0]);
+  if (out.f == NULL) {
+    fprintf(stderr, "Could not create file: %s\n", argv[0]);
+    return 1;
+  }
+  out.info = fopen("/dev/null", "w");
+  if (out.info == NULL) {
+    return 1;
+  }
+  init_simple_mutex(&out.mutex);
+
+  // The searches stop at their depth or node limit, never on time
+  init_abort_timer(NO_TIME_LIMIT);
+  reset_abort();
+  init_tics();
+
+  out.start = milliseconds();
+  #ifdef PARALLEL
+    cilk_for (uint64_t i = 0; i < games; i++) {
+      run_game(start, i, &cfg, &out);
+    }
+  #else
+    for (uint64_t i = 0; i < games; i++) {
+      run_game(start, i, &cfg, &out);
+    }
+  #endif
+  report(&out);
+
+  fclose(out.info);
+  free(start);
+  if (fclose(out.f) != 0 || out.failed) {
+    fprintf(stderr, "%s: could not write every record\n", argv[0]);
+    return 1;
+  }
+  return 0;
+}
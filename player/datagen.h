@@ -0,0 +1,20 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Self-play training data, generated as `leiserchess datagen`.
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+// leiserchess datagen <dataset> <games> [depth <d>] [nodes <n>]
+//                     [random <plies>] [seed <s>]
+//
+// Plays games of the engine against itself from the starting position, each
+// opened with random moves, and writes the positions they reach to dataset
+// (dataset.h), each with the score of its search and the outcome of its game.
+// seed fixes the random moves and the searches' root move orders, so a
+// serial build writes the same dataset for the same seed.  Games run at once
+// on the Cilk workers.  Reports progress and positions per second on stderr.
+// Returns the exit status.
+int datagen_main(int argc, char* argv[]);
+
+#endif  // DATAGEN_H
@@ -0,0 +1,178 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#include "dataset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+#include "fen.h"
+#include "move_gen.h"
+#include "nnue.h"
+
+void pos_to_record(position_t* p, dataRecord_t* r) {
+  memset(r, 0, sizeof(*r));
+  r->piece_loc[WHITE] = p->piece_loc[WHITE];
+  r->piece_loc[BLACK] = p->piece_loc[BLACK];
+  r->monarchs = p->monarchs;
+  r->ori_bits[0] = p->ori_bits[0];
+  r->ori_bits[1] = p->ori_bits[1];
+  r->side = color_to_move_of(p);
+}
+
+int record_to_pos(const dataRecord_t* r, position_t* p) {
+  uint64_t occupied = r->piece_loc[WHITE] | r->piece_loc[BLACK];
+  if ((r->piece_loc[WHITE] & r->piece_loc[BLACK]) != 0 ||
+      (r->monarchs & ~occupied) != 0 ||
+      ((r->ori_bits[0] | r->ori_bits[1]) & ~occupied) != 0 ||
+      __builtin_popcountll(r->monarchs & r->piece_loc[WHITE]) > MAX_MONARCHS ||
+      __builtin_popcountll(r->monarchs & r->piece_loc[BLACK]) > MAX_MONARCHS ||
+      r->side > BLACK || r->result > WHITE_WON) {
+    return 1;
+  }
+
+  memset(p, 0, sizeof(*p));
+  p->piece_loc[WHITE] = r->piece_loc[WHITE];
+  p->piece_loc[BLACK] = r->piece_loc[BLACK];
+  p->monarchs = r->monarchs;
+  p->ori_bits[0] = r->ori_bits[0];
+  p->ori_bits[1] = r->ori_bits[1];
+  p->ply = r->side;
+  p->last_move = NULL_MOVE;
+
+  // as fen_to_pos() finishes a position
+  update_lasers(p);
+  eval_acc_init(p);
+  p->pawn_key = compute_pawn_key(p);
+  if (USE_NNUE) {
+    nnue_refresh(p);
+  }
+  p->key = compute_zob_key(p);
+  p->sym_key = compute_sym_key(p);
+  p->reps = NULL;
+  p->cold.history = NULL;
+  return 0;
+}
+
+FILE* dataset_create(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL) {
+    return NULL;
+  }
+  uint32_t header[3] = {DATASET_VERSION, sizeof(dataRecord_t), 0};
+  if (fwrite("LCDR", 1, 4, f) != 4 ||
+      fwrite(header, sizeof(uint32_t), 3, f) != 3) {
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+int dataset_write(FILE* f, const dataRecord_t* records, size_t n) {
+  return fwrite(records, sizeof(dataRecord_t), n, f) == n ? 0 : 1;
+}
+
+// Reads the records that follow the header of a binary dataset
+static dataRecord_t* read_records(FILE* f, const char* path, size_t* n) {
+  uint32_t header[3];
+  if (fread(header, sizeof(uint32_t), 3, f) != 3 ||
+      header[0] != DATASET_VERSION || header[1] != sizeof(dataRecord_t)) {
+    fprintf(stderr, "%s: not a version %d dataset\n", path, DATASET_VERSION);
+    return NULL;
+  }
+
+  long start = ftell(f);
+  fseek(f, 0, SEEK_END);
+  long bytes = ftell(f) - start;
+  fseek(f, start, SEEK_SET);
+  if (bytes % sizeof(dataRecord_t) != 0) {
+    fprintf(stderr, "%s: truncated record\n", path);
+    return NULL;
+  }
+
+  *n = bytes / sizeof(dataRecord_t);
+  dataRecord_t* records = malloc(*n * sizeof(dataRecord_t) + 1);
+  if (records == NULL ||
+      fread(records, sizeof(dataRecord_t), *n, f) != *n) {
+    fprintf(stderr, "%s: could not read %zu records\n", path, *n);
+    free(records);
+    return NULL;
+  }
+  return records;
+}
+
+// Reads "<fen>,<outcome>" lines
+static dataRecord_t* read_fens(FILE* f, const char* path, size_t* n) {
+  size_t capacity = 1024;
+  dataRecord_t* records = malloc(capacity * sizeof(dataRecord_t));
+  position_t* p;
+  if (records == NULL ||
+      posix_memalign((void**)&p, CACHE_LINE_SIZE, sizeof(position_t)) != 0) {
+    fprintf(stderr, "%s: out of memory\n", path);
+    free(records);
+    return NULL;
+  }
+
+  char line[MAX_FEN_CHARS + 64];
+  size_t line_no = 0;
+  *n = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    line_no++;
+    char* comma = strrchr(line, ',');
+    if (comma == NULL) {
+      if (strspn(line, " \t\r\n") == strlen(line)) {
+        continue;  // blank line
+      }
+      fprintf(stderr, "%s:%zu: expected <fen>,<outcome>\n", path, line_no);
+      break;
+    }
+    *comma = '\0';
+    double outcome = strtod(comma + 1, NULL);
+    if (fen_to_pos(p, line) != 0) {
+      fprintf(stderr, "%s:%zu: bad fen\n", path, line_no);
+      break;
+    }
+
+    if (*n == capacity) {
+      capacity *= 2;
+      dataRecord_t* grown = realloc(records, capacity * sizeof(dataRecord_t));
+      if (grown == NULL) {
+        fprintf(stderr, "%s:%zu: out of memory\n", path, line_no);
+        free(records);
+        free(p);
+        return NULL;
+      }
+      records = grown;
+    }
+    pos_to_record(p, &records[*n]);
+    records[*n].result = outcome > 0.75 ? WHITE_WON
+                         : outcome < 0.25 ? BLACK_WON : DRAWN;
+    (*n)++;
+  }
+
+  free(p);
+  if (!feof(f)) {
+    free(records);
+    return NULL;
+  }
+  return records;
+}
+
+dataRecord_t* dataset_read(const char* path, size_t* n) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file: %s\n", path);
+    return NULL;
+  }
+
+  char magic[4];
+  dataRecord_t* records;
+  if (fread(magic, 1, 4, f) == 4 && memcmp(magic, "LCDR", 4) == 0) {
+    records = read_records(f, path, n);
+  } else {
+    rewind(f);
+    records = read_fens(f, path, n);
+  }
+  fclose(f);
+  return records;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "move_gen.h"
+
+// -----------------------------------------------------------------------------
+// Training data
+// -----------------------------------------------------------------------------
+
+// Positions labelled with the outcome of the game they were played in, as
+// self-play writes them (datagen.c), for tuning the evaluator (tune.c).  A
+// file is a header followed by records, all little-endian:
+//   char    magic[4]      "LCDR"
+//   uint32  version       DATASET_VERSION
+//   uint32  record_size   sizeof(dataRecord_t)
+//   uint32  reserved      0
+//   dataRecord_t records[]
+#define DATASET_VERSION 1
+
+// Outcome of the game, in half points for White
+typedef enum { BLACK_WON = 0, DRAWN = 1, WHITE_WON = 2 } gameResult_t;
+
+// One position: the bitplanes of position_t, the side to move, the outcome
+// and, if the position was searched, the score of the search from White's
+// point of view (0 otherwise).
+typedef struct data_record {
+  uint64_t piece_loc[2];
+  uint64_t monarchs;
+  uint64_t ori_bits[2];
+  uint8_t side;    // color_t to move
+  uint8_t result;  // gameResult_t
+  int16_t score;
+  uint32_t reserved;
+} dataRecord_t;
+
+_Static_assert(sizeof(dataRecord_t) == 48,
+               "dataRecord_t is part of the file format");
+
+void pos_to_record(position_t* p, dataRecord_t* r);
+// Sets p up from r, detached from any game history (reps and cold.history are
+// NULL).  Returns 0 on success, 1 if r does not hold a board.
+int record_to_pos(const dataRecord_t* r, position_t* p);
+
+// Creates path and writes the header.  Returns NULL on failure.
+FILE* dataset_create(const char* path);
+// Appends n records.  Returns 0 on success.
+int dataset_write(FILE* f, const dataRecord_t* records, size_t n);
+
+// Reads all of path into an array the caller frees, and its length into *n.
+// A text file of "<fen>,<outcome for White: 0, 0.5 or 1>" lines, as
+// training/datagen.py --fen writes, is read as well.  Returns NULL, having
+// said why on stderr, on failure.
+dataRecord_t* dataset_read(const char* path, size_t* n);
+
+#endif  // DATASET_H
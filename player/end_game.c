@@ -7,13 +7,8 @@
 #include "tbassert.h"
 
 bool player_wins(position_t* p, color_t c) {
-  int white_monarchs = 0;
-  int black_monarchs = 0;
-
-  if (get_monarch(p, WHITE, 0)) white_monarchs ++;
-  if (get_monarch(p, WHITE, 1)) white_monarchs ++;
-  if (get_monarch(p, BLACK, 0)) black_monarchs ++;
-  if (get_monarch(p, BLACK, 1)) black_monarchs ++;
+  int white_monarchs = __builtin_popcountll(monarchs_of(p, WHITE));
+  int black_monarchs = __builtin_popcountll(monarchs_of(p, BLACK));
   
   if (c)
     return ((color_to_move_of(p) == BLACK && white_monarchs < black_monarchs) ||
@@ -31,6 +26,15 @@ bool is_game_over(position_t* p) {
   return player_wins(p, WHITE) || player_wins(p, BLACK);
 }
 
+// is_game_over() for a position with the given Monarch counts, without the
+// position itself.
+bool is_game_over_with(int white_monarchs, int black_monarchs,
+                       color_t color_to_move) {
+  return !white_monarchs || !black_monarchs ||
+         (color_to_move == WHITE && white_monarchs > black_monarchs) ||
+         (color_to_move == BLACK && black_monarchs > white_monarchs);
+}
+
 // check the victim pieces returned by the move to determine if it's a
 // game-over situation.  If so, also calculate the score depending on
 // the pov (which player's point of view)
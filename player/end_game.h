@@ -11,6 +11,8 @@
 bool player_wins(position_t* p, color_t c);
 bool is_end_game_position(position_t* p);
 bool is_game_over(position_t* p);
+bool is_game_over_with(int white_monarchs, int black_monarchs,
+                       color_t color_to_move);
 score_t get_end_game_score(position_t* p, int pov, int ply);
 
 #endif  // END_GAME_H
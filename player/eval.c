@@ -2,21 +2,23 @@
 
 #include "eval.h"
 
-#include <float.h>
-#include <math.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#ifdef PARALLEL
+#include <cilk/cilk_api.h>
+#endif
+
+#include "eval_tables.h"
 #include "move_gen.h"
+#include "nnue.h"
 #include "tbassert.h"
 
 // -----------------------------------------------------------------------------
 // Evaluation
 // -----------------------------------------------------------------------------
-//Set to 0 to turn on Laser Coverage, set to 13 to turn off Laser Coverage
-//Change value to modify when to turn on laser coverage
-// #define PAWN_LIMIT 0
-
 typedef int32_t ev_score_t;  // Static evaluator uses "hi res" values
 
 int RANDOMIZE;
@@ -32,25 +34,18 @@ int PMAT_weight = PAWN_EV_VALUE;
 int RELQI_weight;
 int ABSQI_weight;
 
-enum heuristics_t {
-  PTOUCH,
-  PPROX,
-  MFACE,
-  MCEDE,
-  LCOVERAGE,
-  PMID,
-  MMID,
-  PMAT,
-  RELQI,
-  ABSQI,
-  NUM_HEURISTICS
-};
 char* heuristic_strs[NUM_HEURISTICS] = {"PTOUCH",    "PPROX", "MFACE", "MCEDE",
                                         "LCOVERAGE", "PMID",  "MMID",  "PMAT",
                                         "RELQI",     "ABSQI"};
-// Boolean array for heuristics that scale along floating point values
-// (versus those that are directly proportional to pawn values)
-bool floating_point_heuristics[NUM_HEURISTICS] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 1};
+// Boolean array for heuristics scored in ev_score_t units, a Pawn being
+// PAWN_EV_VALUE, whose weights are scaled down by PAWN_EV_VALUE (versus those
+// that count whole units and are directly proportional to pawn values)
+static const bool ev_scaled_heuristics[NUM_HEURISTICS] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 1};
+
+int* const heuristic_weights[NUM_HEURISTICS] = {
+    &PTOUCH_weight, &PPROX_weight, &MFACE_weight, &MCEDE_weight,
+    &LCOVERAGE_weight, &PMID_weight, &MMID_weight, &PMAT_weight,
+    &RELQI_weight, &ABSQI_weight};
 
 static const ev_score_t centrality_lookup_table[BOARD_SIZE] = {
 0,1,2,3,3,2,1,0,
@@ -63,215 +58,100 @@ static const ev_score_t centrality_lookup_table[BOARD_SIZE] = {
 0,1,2,3,3,2,1,0
 };
 
-static const uint64_t neighbors[100] = {
-  0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 
-  0ULL, 770ULL, 1797ULL, 3594ULL, 7188ULL, 14376ULL, 28752ULL, 57504ULL, 49216ULL, 0ULL, 
-  0ULL, 197123ULL, 460039ULL, 920078ULL, 1840156ULL, 3680312ULL, 7360624ULL, 14721248ULL, 12599488ULL, 0ULL, 
-  0ULL, 50463488ULL, 117769984ULL, 235539968ULL, 471079936ULL, 942159872ULL, 1884319744ULL, 3768639488ULL, 3225468928ULL, 0ULL, 
-  0ULL, 12918652928ULL, 30149115904ULL, 60298231808ULL, 120596463616ULL, 241192927232ULL, 482385854464ULL, 964771708928ULL, 825720045568ULL, 0ULL, 
-  0ULL, 3307175149568ULL, 7718173671424ULL, 15436347342848ULL, 30872694685696ULL, 61745389371392ULL, 123490778742784ULL, 246981557485568ULL, 211384331665408ULL, 0ULL, 
-  0ULL, 846636838289408ULL, 1975852459884544ULL, 3951704919769088ULL, 7903409839538176ULL, 15806819679076352ULL, 31613639358152704ULL, 63227278716305408ULL, 54114388906344448ULL, 0ULL, 
-  0ULL, 216739030602088448ULL, 505818229730443264ULL, 1011636459460886528ULL, 2023272918921773056ULL, 4046545837843546112ULL, 8093091675687092224ULL, 16186183351374184448ULL, 13853283560024178688ULL, 0ULL, 
-  0ULL, 144959613005987840ULL, 362258295026614272ULL, 724516590053228544ULL, 1449033180106457088ULL, 2898066360212914176ULL, 5796132720425828352ULL, 11592265440851656704ULL, 4665729213955833856ULL, 0ULL, 
-  0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL
-};
-
-static const double inverse[16] = {1.0/1, 1.0/2, 1.0/3, 1.0/4, 1.0/5, 1.0/6, 1.0/7, 1.0/8, 1.0/9, 1.0/10, 1.0/11, 1.0/12, 1.0/13, 1.0/14, 1.0/15, 1.0/16};
-
-// static const float delta_ratio_mult_dist_lookup[BOARD_WIDTH] = {1.0f / 1.0f, 1.0f / 2.0f, 1.0f / 3.0f, 1.0f / 4.0f, 1.0f / 5.0f, 1.0f / 6.0f, 1.0f / 7.0f, 1.0f / 8.0f};
-
 // Heuristics for static evaluation - described in the leiserchess codewalk
 // slides
 
 // For PTOUCH heuristic: Does a Pawn touch a neighboring Pawn?
 bool static inline __attribute__((always_inline)) p_touch(uint64_t pawns, square_t sq) {
-  return pawns & neighbors[sq];
+  return pawns & neighbors_of(sq_to_bit(sq));
 }
 
 // test routine for do_pawns_touch()
 void test_ptouch(position_t* p) {
   char sq_str[MAX_CHARS_IN_MOVE];
-
-  for (fil_t f = 0; f < BOARD_WIDTH; f++) {
-    for (rnk_t r = 0; r < BOARD_WIDTH; r++) {
-      square_t sq = square_of(f, r);
-      piece_t piece = p->board[sq];
-      ptype_t piece_type = ptype_of(piece);
-
-      if (piece_type == PAWN) {  // find a Pawn
-        square_to_str(sq, sq_str, MAX_CHARS_IN_MOVE);
-
-        for (int d = 0; d < NUM_DIR; d++) {  // search surrounding squares
-          square_t curr_sq = sq + dir_of((compass_t)d);
-          piece_t curr_piece = p->board[curr_sq];
-          if (ptype_of(curr_piece) == PAWN) {
-            if (do_pawns_touch((pawn_ori_t) ori_of(piece), (pawn_ori_t) ori_of(curr_piece),
-                               (compass_t)d)) {
-              square_to_str(curr_sq, sq_str, MAX_CHARS_IN_MOVE);
-            }
-          }
-        }
+  uint64_t pawns = pawns_of(p, WHITE) | pawns_of(p, BLACK);
+
+  for (uint64_t rest = pawns; rest; rest &= rest - 1) {  // find a Pawn
+    square_t sq = __builtin_ctzll(rest);
+    piece_t piece = piece_at(p, sq);
+    square_to_str(sq, sq_str, MAX_CHARS_IN_MOVE);
+
+    for (int d = 0; d < NUM_DIR; d++) {  // search surrounding squares
+      square_t curr_sq = sq + dir_of((compass_t)d);
+      if (curr_sq >= BOARD_SIZE ||
+          !((neighbors_of(sq_to_bit(sq)) & pawns) >> curr_sq & 1)) {
+        continue;
+      }
+      piece_t curr_piece = piece_at(p, curr_sq);
+      if (do_pawns_touch((pawn_ori_t) ori_of(piece), (pawn_ori_t) ori_of(curr_piece),
+                         (compass_t)d)) {
+        square_to_str(curr_sq, sq_str, MAX_CHARS_IN_MOVE);
       }
     }
   }
 }
 
-ev_score_t static inline __attribute__((always_inline)) mface_pair( piece_t piece, int8_t delta_fil, int8_t delta_rnk) {
-  int bonus = 0;
-  
-  switch ((monarch_ori_t) ori_of(piece)) {
-    case NN:
-      bonus = delta_rnk;
-      break;
-    case EE:
-      bonus = delta_fil;
-      break;
-    case SS:
-      bonus = -delta_rnk;
-      break;
-    case WW:
-      bonus = -delta_fil;
-      break;
-    default:
-      tbassert(false, "Illegal Monarch orientation.\n");
-  }
-  return (bonus * PAWN_EV_VALUE) * inverse[(abs(delta_rnk) + abs(delta_fil)) - 1];
-}
+// The evaluator is integer throughout: the square-to-square tables below come
+// from eval_tables.h, generated at build time by gen_eval_tables.c, and scores
+// are scaled in whole ev_score_t units, so no float rounding enters a score.
 
 // MFACE heuristic: bonus (or penalty) for Monarch facing toward the other
 // Monarch
-ev_score_t static inline __attribute__((always_inline)) mface(position_t* p, piece_t piece, fil_t f, rnk_t r) {
+ev_score_t static inline __attribute__((always_inline)) mface(position_t* p, piece_t piece, square_t sq) {
   color_t c = color_of(piece);
   ev_score_t total = 0;
-  square_t opp_sq = get_monarch(p, opp_color(c), 0);
-  
-  if (ptype_of(p->board[opp_sq]) == MONARCH) {
-    int8_t delta_fil = fil_of(opp_sq) - f;
-    int8_t delta_rnk = rnk_of(opp_sq) - r;
-    total += mface_pair(piece, delta_fil, delta_rnk);
-  }
-  opp_sq = get_monarch(p, opp_color(c), 1);
-  
-  if (ptype_of(p->board[opp_sq]) == MONARCH) {
-    int8_t delta_fil = fil_of(opp_sq) - f;
-    int8_t delta_rnk = rnk_of(opp_sq) - r;
-    total += mface_pair(piece, delta_fil, delta_rnk);
-  }
-  return total;
-}
-
-ev_score_t static inline __attribute__((always_inline)) mcede_pair(fil_t f, rnk_t r, int8_t delta_fil, int8_t delta_rnk) {
 
-  int penalty = 0;
-  if (delta_fil * EAST >= 0 && delta_rnk * NORTH >= 0) {  // NE quadrant
-    penalty = (BOARD_WIDTH - f) * (BOARD_WIDTH - r);
-  } else if (delta_fil * EAST >= 0 && delta_rnk * SOUTH >= 0) {  // SE quadrant
-    penalty = (BOARD_WIDTH - f) * (r + 1);
-  } else if (delta_fil * WEST >= 0 && delta_rnk * SOUTH >= 0) {  // SW quadrant
-    penalty = (f + 1) * (r + 1);
-  } else if (delta_fil * WEST >= 0 && delta_rnk * NORTH >= 0) {  // NW quadrant
-    penalty = (f + 1) * (BOARD_WIDTH - r);
-  } else {
-    tbassert(false,
-             "You need some direction in life!\n");  // Shouldn't happen.
+  for (uint64_t opp = monarchs_of(p, opp_color(c)); opp; opp &= opp - 1) {
+    total += mface_table[sq][__builtin_ctzll(opp)][ori_of(piece)];
   }
-  return (PAWN_EV_VALUE * penalty) / (BOARD_WIDTH * BOARD_WIDTH);
+  return total;
 }
 
 // MCEDE heuristic: penalty for ceding opp Monarch room to move.
-ev_score_t static inline __attribute__((always_inline)) mcede(position_t* p, piece_t piece, fil_t f, rnk_t r) {
-
+ev_score_t static inline __attribute__((always_inline)) mcede(position_t* p, piece_t piece, square_t sq) {
   color_t c = color_of(piece);
   ev_score_t total = 0;
   tbassert(ptype_of(piece) == MONARCH, "piece.typ = %d\n", ptype_of(piece));
 
-  square_t opp_sq = get_monarch(p, opp_color(c), 0);
-  
-  if (ptype_of(p->board[opp_sq]) == MONARCH) {
-    int8_t delta_fil = fil_of(opp_sq) - f;
-    int8_t delta_rnk = rnk_of(opp_sq) - r;
-    total += mcede_pair(f, r, delta_fil, delta_rnk);
-  }
-  opp_sq = get_monarch(p, opp_color(c), 1);
-  if (ptype_of(p->board[opp_sq]) == MONARCH) {
-    int8_t delta_fil = fil_of(opp_sq) - f;
-    int8_t delta_rnk = rnk_of(opp_sq) - r;
-    total += mcede_pair(f, r, delta_fil, delta_rnk);
+  for (uint64_t opp = monarchs_of(p, opp_color(c)); opp; opp &= opp - 1) {
+    total += mcede_table[sq][__builtin_ctzll(opp)];
   }
 
   return total;
 }
 
-// Marks the path/line-of-sight of the laser until it hits a piece or goes off
-// the board.
-// Increment for each time you touch a square with the laser
-//
-// p : Current board state.
-// c : Color of monarch shooting laser.
-// laser_map : End result will be stored here. Every square on the
-//             path of the laser is marked with mark_mask.
-// mark_mask : What each square is marked with.
-void add_laser_path(position_t* p, color_t c, float* laser_map, int n) {
-  tbassert(n == 0 || n == 1, "bad monarch index %d\n", n);
-  square_t sq = get_monarch(p, c, n);
-  int bdir = (int) ori_of(p->board[sq]);
-  int length = 1;
-;
-  if (!sq) return;
-  tbassert(ptype_of(p->board[sq]) == MONARCH, "ptype: %d, sq: %d, n: %d\n",
-           ptype_of(p->board[sq]), sq, n);
-
-  while (true) {
-    sq += beam_of(bdir);
-    // set laser map to min
-    
-    if (laser_map[sq] > length) {
-      laser_map[sq] = length;
-    }
-    length++;
-
-    tbassert(sq < ARR_SIZE && sq >= 0, "sq: %d\n", sq);
-
-    switch (ptype_of(p->board[sq])) {
-      case EMPTY:  // empty square
-        break;
-      case PAWN:  // Pawn
-        bdir = reflect_of(bdir, ori_of(p->board[sq]));
-        if (bdir < 0) {  // Hit back of Pawn
-          return;
-        }
-        break;
-      case MONARCH:  // Monarch
-        return;      // sorry, game over my friend!
-        break;
-      case INVALID:  // Ran off edge of board
-        return;
-        break;
-      default:  // Shouldna happen, man!
-        tbassert(false, "Not cool, man.  Not cool.\n");
-        break;
-    }
+// LCOVERAGE heuristic: Monarchs should bring their lasers to bear on the
+// opposing Monarchs.  Counts the squares next to an opposing Monarch that the
+// beams of color c cover, reflections included, and counts an opposing
+// Monarch's own square, where the beam would zap it, twice.  The beams are
+// the ones make_move() keeps in p->lasers, so this costs a few popcounts.
+ev_score_t static inline __attribute__((always_inline)) lcoverage(position_t* p, color_t c) {
+  uint64_t covered = 0;
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    covered |= p->lasers.path[c][n];
   }
+  uint64_t targets = monarchs_of(p, opp_color(c));
+  int count = 2 * __builtin_popcountll(covered & targets) +
+              __builtin_popcountll(covered & neighbors_of(targets) & ~targets);
+  return count * PAWN_EV_VALUE;
 }
 
-float static inline __attribute__((always_inline)) mult_dist(float delta_fil, float delta_rnk) {
-  if (delta_fil == 0 && delta_rnk == 0) {
-    return 2;
+#define GET_CENTRAL(f,r) centrality_lookup_table[square_of(f, r)]
+
+// PPROXimity heuristic: Pawns should try to be proximate to Monarchs
+// according to harmonic-ish distance metric.  Returns the bonus of a Pawn on
+// sq for the given Monarchs of both colors.
+ev_score_t static inline __attribute__((always_inline)) pprox(uint64_t monarchs, square_t sq) {
+  int pweight = 0;  // in units of 1 / H_DIST_ONE
+
+  // calculate pweight over the Monarchs of both colors
+  for (uint64_t m = monarchs; m; m &= m - 1) {
+    pweight += h_dist_table[sq][__builtin_ctzll(m)];
   }
-  float x = (1 / (delta_fil + 1)) * (1 / (delta_rnk + 1));
-  return x;
-}
 
-// Harmonic-ish distance: 1/(|dx|+1) + 1/(|dy|+1)
-float static inline __attribute__((always_inline)) h_dist(rnk_t rnk_a, fil_t fil_a, square_t b) {
-  int delta_fil = abs(fil_a - fil_of(b));
-  int delta_rnk = abs(rnk_a - rnk_of(b));
-  float x = inverse[delta_fil] + inverse[delta_rnk];
-  return x;
+  return pweight * PAWN_EV_VALUE / H_DIST_ONE; //REMOVED scaling
 }
 
-#define GET_CENTRAL(f,r) centrality_lookup_table[f<<3 | r]
-
 // Distance from the center: D^2 - d^2 where D is the maximum Euclidean distance
 // from the center possible
 ev_score_t concave_centrality(fil_t f, rnk_t r) {
@@ -284,56 +164,46 @@ ev_score_t concave_centrality(fil_t f, rnk_t r) {
 }
 
 //OPTIMIZED with piece_loc
-float static inline __attribute__((always_inline)) abs_qi(position_t* p, color_t target_color) {
+ev_score_t static inline __attribute__((always_inline)) abs_qi(position_t* p, color_t target_color) {
   int qi = 0;
-  uint64_t pieces = p->piece_loc[target_color];
-  while (pieces) {
-    uint64_t loc = pieces & (-pieces);
-    pieces ^= loc;
-    uint8_t sq64 = __builtin_ctzll(loc);
-    square_t sq = sq_to_bit_index[sq64];
-
-    if (ptype_of(p->board[sq]) == PAWN) {
-      qi += qi_at(sq);
-    }
+  uint64_t pawns = pawns_of(p, target_color);
+  while (pawns) {
+    qi += qi_at(__builtin_ctzll(pawns));
+    pawns &= pawns - 1;
   }
-  return (float) qi;
+  return qi * PAWN_EV_VALUE;
 }
 
-//OPTIMIZED with piece_loc
-float static inline __attribute__((always_inline)) rel_qi(position_t* p) {
+// The squares of each Qi value in qi_at(), lowest value first: 0, 24, 40, 48,
+// 64, 72, 80, 88, 96.  Every square of a level has a higher Qi than every
+// square of the levels before it.
+#define NUM_QI_LEVELS 9
+
+static const uint64_t qi_level_masks[NUM_QI_LEVELS] = {
+    0x8100000000000081ULL, 0x4281000000008142ULL, 0x2400810000810024ULL,
+    0x1842008181004218ULL, 0x0024420000422400ULL, 0x0018004242001800ULL,
+    0x0000240000240000ULL, 0x0000182424180000ULL, 0x0000001818000000ULL};
+
+#ifndef NDEBUG
+// rel_qi() by comparing every White Pawn with every Black Pawn, to check the
+// level counts against
+static ev_score_t rel_qi_pairwise(position_t* p) {
   int qi = 0;
   square_t black_pawns[MAX_NUM_PAWNS_PER_COLOR];
   square_t white_pawns[MAX_NUM_PAWNS_PER_COLOR];
   int black_pawns_count = 0, white_pawns_count = 0;
 
-  uint64_t white_pieces = p->piece_loc[WHITE];
-  uint64_t black_pieces = p->piece_loc[BLACK];
-
-  square_t monarch[2][2] ;
-  monarch[WHITE][0] = get_monarch(p, WHITE, 0);
-  monarch[WHITE][1] = get_monarch(p, WHITE, 1);
-  monarch[BLACK][0] = get_monarch(p, BLACK, 0);
-  monarch[BLACK][1] = get_monarch(p, BLACK, 1);
-  //remove monarch set bits from white_pieces and black_pieces
-  white_pieces ^= (sq_to_bitmask[monarch[WHITE][0]]);
-  white_pieces ^= (sq_to_bitmask[monarch[WHITE][1]]);
-  black_pieces ^= (sq_to_bitmask[monarch[BLACK][0]]);
-  black_pieces ^= (sq_to_bitmask[monarch[BLACK][1]]);
-  
+  uint64_t white_pieces = pawns_of(p, WHITE);
+  uint64_t black_pieces = pawns_of(p, BLACK);
 
   while (white_pieces) {
-    uint64_t w_loc = (white_pieces) & (-white_pieces);
-    square_t w_sq = __builtin_ctzll(w_loc);
-    white_pawns[white_pawns_count++] = sq_to_bit_index[w_sq];
-    white_pieces ^= w_loc;
+    white_pawns[white_pawns_count++] = __builtin_ctzll(white_pieces);
+    white_pieces &= white_pieces - 1;
   }
 
   while (black_pieces) {
-    uint64_t b_loc = (black_pieces) & (-black_pieces);
-    square_t b_sq = __builtin_ctzll(b_loc);
-    black_pawns[black_pawns_count++] = sq_to_bit_index[b_sq];
-    black_pieces ^= b_loc;
+    black_pawns[black_pawns_count++] = __builtin_ctzll(black_pieces);
+    black_pieces &= black_pieces - 1;
   }
   // if white > black: 1; white < black: -1; otherwise 0)
   for (int i = 0; i < white_pawns_count; i++) {
@@ -345,43 +215,59 @@ float static inline __attribute__((always_inline)) rel_qi(position_t* p) {
       }
     }
   }
-  return ((float)qi /
-          ((float)((white_pawns_count + 1) * (black_pawns_count + 1))));
+  return qi * PAWN_EV_VALUE /
+         ((white_pawns_count + 1) * (black_pawns_count + 1));
 }
+#endif
+
+// RELQI heuristic: over all pairs of a White and a Black Pawn, +1 if the
+// White Pawn stands on the higher Qi, -1 if the Black one does.  Counting the
+// Pawns of each color on each Qi level gives every pair at once: the White
+// Pawns of a level beat the Black Pawns of the levels below it and lose to
+// those of the levels above.  Scaled to a Pawn's worth for the most lopsided
+// board.
+ev_score_t static inline __attribute__((always_inline)) rel_qi(position_t* p) {
+  uint64_t white_pawns = pawns_of(p, WHITE);
+  uint64_t black_pawns = pawns_of(p, BLACK);
+  int white_pawns_count = __builtin_popcountll(white_pawns);
+  int black_pawns_count = __builtin_popcountll(black_pawns);
 
-// Static evaluation.  Returns score
-score_t eval(position_t* p, bool verbose) {
-  // seed rand_r with a value of 1, as per
-  // https://linux.die.net/man/3/rand_r
-  // static __thread unsigned int seed = 1; //not using RANDOMIZE
+  int qi = 0;
+  int black_below = 0;  // Black Pawns on the levels below level l
+  for (int l = 0; l < NUM_QI_LEVELS; l++) {
+    int white = __builtin_popcountll(white_pawns & qi_level_masks[l]);
+    int black = __builtin_popcountll(black_pawns & qi_level_masks[l]);
+    int black_above = black_pawns_count - black_below - black;
+    qi += white * (black_below - black_above);
+    black_below += black;
+  }
 
-  // verbose = true: print out components of score
-  ev_score_t score[2][NUM_HEURISTICS] = {0};
-  char sq_str[MAX_CHARS_IN_MOVE];
+  ev_score_t rel = qi * PAWN_EV_VALUE /
+                   ((white_pawns_count + 1) * (black_pawns_count + 1));
+  tbassert(rel == rel_qi_pairwise(p), "rel_qi %d, pairwise %d\n", rel,
+           rel_qi_pairwise(p));
+  return rel;
+}
 
-  square_t monarch[2][2] = {};
-  monarch[WHITE][0] = get_monarch(p, WHITE, 0);
-  monarch[WHITE][1] = get_monarch(p, WHITE, 1);
-  monarch[BLACK][0] = get_monarch(p, BLACK, 0);
-  monarch[BLACK][1] = get_monarch(p, BLACK, 1);
+// Scores every heuristic but LCOVERAGE by walking all the pieces of both
+// colors.  This is the reference the accumulators in p->acc and the Pawn hash
+// table are checked against.
+static void eval_pieces(position_t* p, ev_score_t score[2][NUM_HEURISTICS],
+                        bool verbose) {
+  char sq_str[MAX_CHARS_IN_MOVE];
 
-  uint64_t pawns = p->piece_loc[BLACK] | p->piece_loc[WHITE];
-  pawns &= ~sq_to_bitmask[monarch[WHITE][0]];
-  pawns &= ~sq_to_bitmask[monarch[WHITE][1]];
-  pawns &= ~sq_to_bitmask[monarch[BLACK][0]];
-  pawns &= ~sq_to_bitmask[monarch[BLACK][1]];
+  uint64_t pawns = (p->piece_loc[BLACK] | p->piece_loc[WHITE]) & ~p->monarchs;
 
   for (color_t c= 0; c<= 1; c++) {
     uint64_t pieces = p->piece_loc[c];
 
     while (pieces) {
-      uint64_t loc = pieces & (-pieces);
-      square_t sq = sq_to_bit_index[__builtin_ctzll(loc)];
-      piece_t piece = p->board[sq];
+      square_t sq = __builtin_ctzll(pieces);
+      piece_t piece = piece_at(p, sq);
       fil_t f = fil_of(sq);
       rnk_t r = rnk_of(sq);
       
-      pieces ^= loc;
+      pieces &= pieces - 1;
       if (verbose) {
         square_to_str(sq, sq_str, MAX_CHARS_IN_MOVE);
       }
@@ -405,22 +291,8 @@ score_t eval(position_t* p, bool verbose) {
             }
           }
 
-          // PPROXimity heuristic: Pawns should try to be proximate to
-          // Monarchs according to harmonic-ish distance metric.
-          float pweight = 0;
-
-          // calculate pweight for white
-          if (monarch[WHITE][0] > 0)
-            pweight += h_dist(r, f, monarch[WHITE][0]);
-          if (monarch[WHITE][1] > 0)
-            pweight += h_dist(r, f, monarch[WHITE][1]);
-          // calculate pweight for white
-          if (monarch[BLACK][0] > 0)
-            pweight += h_dist(r, f, monarch[BLACK][0]);
-          if (monarch[BLACK][1] > 0)
-            pweight += h_dist(r, f, monarch[BLACK][1]);
-
-          ev_score_t prox_bonus = pweight * PAWN_EV_VALUE; //REMOVED scaling
+          // PPROXimity heuristic
+          ev_score_t prox_bonus = pprox(p->monarchs, sq);
           score[c][PPROX] += prox_bonus;
           if (verbose) {
             printf("PPROXimity bonus %d for %s Pawn on %s\n", prox_bonus,
@@ -439,7 +311,7 @@ score_t eval(position_t* p, bool verbose) {
         } 
         case MONARCH: {
           // MFACE heuristic
-          ev_score_t kface_bonus = mface(p, piece, f, r);
+          ev_score_t kface_bonus = mface(p, piece, sq);
           score[c][MFACE] += kface_bonus;
           if (verbose) {
             printf("MFACE bonus %d for %s Monarch on %s\n", kface_bonus,
@@ -447,7 +319,7 @@ score_t eval(position_t* p, bool verbose) {
           }
 
           // MCEDE heuristic
-          ev_score_t penalty = mcede(p, piece, f, r);
+          ev_score_t penalty = mcede(p, piece, sq);
           score[c][MCEDE] -= penalty;
           if (verbose) {
             printf("MCEDE penalty %d for %s Monarch on %s\n", penalty,
@@ -474,48 +346,486 @@ score_t eval(position_t* p, bool verbose) {
     }
   }
 
-  // RELQI heuristic
-  score[WHITE][RELQI] = PAWN_EV_VALUE * rel_qi(p);
+  score[WHITE][RELQI] = rel_qi(p);
   score[BLACK][RELQI] = -score[WHITE][RELQI];
+  score[WHITE][ABSQI] = abs_qi(p, WHITE);
+  score[BLACK][ABSQI] = abs_qi(p, BLACK);
+}
 
-  score[WHITE][ABSQI] = PAWN_EV_VALUE * abs_qi(p, WHITE);
-  score[BLACK][ABSQI] = PAWN_EV_VALUE * abs_qi(p, BLACK);
+// -----------------------------------------------------------------------------
+// Incremental evaluation
+// -----------------------------------------------------------------------------
 
-  int weights[NUM_HEURISTICS] = {
-      PTOUCH_weight, PPROX_weight, MFACE_weight, MCEDE_weight, LCOVERAGE_weight,
-      PMID_weight,   MMID_weight,  PMAT_weight,  RELQI_weight, ABSQI_weight};
+// Sums the Monarch terms and PPROX of p into p->acc from scratch.
+static void acc_sum_monarch_terms(position_t* p) {
+  evalAcc_t* acc = &p->acc;
+  for (color_t c = 0; c <= 1; c++) {
+    ev_score_t mmid = 0, kface = 0, kcede = 0, prox = 0;
+    for (uint64_t m = monarchs_of(p, c); m; m &= m - 1) {
+      square_t sq = __builtin_ctzll(m);
+      piece_t piece = piece_at(p, sq);
+      mmid += centrality_lookup_table[sq];
+      kface += mface(p, piece, sq);
+      kcede += mcede(p, piece, sq);
+    }
+    for (uint64_t pawns = pawns_of(p, c); pawns; pawns &= pawns - 1) {
+      square_t sq = __builtin_ctzll(pawns);
+      prox += pprox(p->monarchs, sq);
+    }
+    acc->mmid[c] = mmid;
+    acc->mface[c] = kface;
+    acc->mcede[c] = kcede;
+    acc->pprox[c] = prox;
+  }
+}
 
-  ev_score_t total_score[2] = {0, 0};
+void eval_acc_init(position_t* p) {
   for (color_t c = 0; c <= 1; c++) {
-    for (int i = 0; i < NUM_HEURISTICS; i++) {
-      ev_score_t bonus;
-      if (floating_point_heuristics[i]) {
-        bonus = score[c][i] * (weights[i] / (float)PAWN_EV_VALUE);
-        if (verbose) {
-        printf("Total %s score of %d for %s\n", heuristic_strs[i],
-                score[c][i], color_to_str(c));
-        }
-      } else {
-        bonus = score[c][i] * weights[i] ;
-        if (verbose) {
-        printf("Total %s score of %d for %s\n", heuristic_strs[i],
-                score[c][i], color_to_str(c));
-        }
+    ev_score_t pmid = 0;
+    for (uint64_t pawns = pawns_of(p, c); pawns; pawns &= pawns - 1) {
+      pmid += centrality_lookup_table[__builtin_ctzll(pawns)];
+    }
+    p->acc.pmid[c] = pmid;
+  }
+  acc_sum_monarch_terms(p);
+}
+
+// Adds (sign = 1) or takes away (sign = -1) the Pawn terms of a Pawn of color
+// c on sq.  PPROX is left alone when it is about to be summed again anyway.
+static inline void acc_pawn(position_t* p, color_t c, square_t sq, int sign,
+                            bool prox) {
+  p->acc.pmid[c] += sign * centrality_lookup_table[sq];
+  if (prox) {
+    p->acc.pprox[c] += sign * pprox(p->monarchs, sq);
+  }
+}
+
+// Brings p->acc up to date after make_move() has made the move recorded in u.
+// The pieces a move can change are the one it moves, the one it pushes and
+// the ones its lasers zap; the Monarchs stay put during all Pawn updates, so
+// a Pawn's PPROX is the same whether it is added or taken away.
+void eval_acc_update(position_t* p, const undo_t* u) {
+  square_t from_sq = from_square(p->last_move);
+  square_t to_sq = to_square(p->last_move);
+  bool moved = from_sq != to_sq;
+  bool turned = !moved && rot_of(p->last_move) != NONE;
+
+  bool monarch_changed = ptype_of(u->moved) == MONARCH && (moved || turned);
+  if (moved && ptype_of(u->pushed) == MONARCH) {
+    monarch_changed = true;
+  }
+  for (int n = 0; n < u->num_zapped; n++) {
+    if (ptype_of(u->zapped[n]) == MONARCH) {
+      monarch_changed = true;
+    }
+  }
+  bool prox = !monarch_changed;
+
+  // A Pawn that only turns keeps all its terms
+  if (moved) {
+    if (ptype_of(u->moved) == PAWN) {
+      acc_pawn(p, color_of(u->moved), from_sq, -1, prox);
+      acc_pawn(p, color_of(u->moved), to_sq, 1, prox);
+    }
+    if (ptype_of(u->pushed) == PAWN) {
+      acc_pawn(p, color_of(u->pushed), to_sq, -1, prox);
+      if (u->push_sq < BOARD_SIZE) {
+        acc_pawn(p, color_of(u->pushed), u->push_sq, 1, prox);
       }
-      
-      total_score[c] += bonus;
-      if (verbose) {
-        printf("Final %s contribution of %d for %s\n", heuristic_strs[i], bonus,
+    }
+  }
+  for (int n = 0; n < u->num_zapped; n++) {
+    if (ptype_of(u->zapped[n]) == PAWN) {
+      acc_pawn(p, color_of(u->zapped[n]), u->zapped_sq[n], -1, prox);
+    }
+  }
+
+  if (monarch_changed) {
+    acc_sum_monarch_terms(p);
+  }
+}
+
+// Scores the heuristics summed in the accumulators, and PMAT, which is a
+// popcount.
+static void eval_acc(position_t* p, ev_score_t score[2][NUM_HEURISTICS]) {
+  for (color_t c = 0; c <= 1; c++) {
+    score[c][PMAT] = __builtin_popcountll(pawns_of(p, c));
+    score[c][PPROX] = p->acc.pprox[c];
+    score[c][PMID] = p->acc.pmid[c];
+    score[c][MFACE] = p->acc.mface[c];
+    score[c][MCEDE] = -p->acc.mcede[c];
+    score[c][MMID] = p->acc.mmid[c];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Statistics
+// -----------------------------------------------------------------------------
+
+// Eval cache and Pawn hash table hits and misses and eval_lazy() outcomes, one
+// slot per worker so that workers don't share lines
+#define EVAL_STAT_SLOTS 128
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t pawn_hits;
+  uint64_t pawn_misses;
+  uint64_t lazy_fast;  // settled by the accumulated terms alone
+  uint64_t lazy_full;  // needed the full evaluation
+} __attribute__((aligned(CACHE_LINE_SIZE))) evalStats_t;
+
+static evalStats_t eval_stats[EVAL_STAT_SLOTS];
+
+static inline evalStats_t* my_eval_stats() {
+  #ifdef PARALLEL
+    int worker = __cilkrts_get_worker_number();
+  #else
+    int worker = 0;
+  #endif
+  return &eval_stats[worker & (EVAL_STAT_SLOTS - 1)];
+}
+
+void eval_reset_stats() {
+  memset(eval_stats, 0, sizeof(eval_stats));
+}
+
+// -----------------------------------------------------------------------------
+// Pawn hash table
+// -----------------------------------------------------------------------------
+
+int PAWN_HASH;  // Pawn hash table size in MBytes; 0 disables it
+
+// PTOUCH, RELQI and ABSQI depend on nothing but where the Pawns of each color
+// stand, and Pawns move far less often than Monarchs turn, so these terms are
+// kept by Pawn key (see compute_pawn_key()).  They are stored unweighted, so
+// entries stay good when the weights change.  An entry is written as two words
+// without locking: check is the key XORed with data, so an entry torn by two
+// workers writing at once fails the key test instead of being believed.
+//
+// PMID depends on the Pawns alone too, but the accumulators have it for free.
+//
+// https://www.chessprogramming.org/Pawn_Hash_Table
+// https://www.chessprogramming.org/Shared_Hash_Table#Lockless
+typedef struct {
+  uint64_t check;
+  uint64_t data;
+} pawnHashEntry_t;
+
+static pawnHashEntry_t* pawn_hash = NULL;
+static uint64_t pawn_hash_mask = 0;
+
+// data packs, from bit 0 up: the number of touching White Pawns and of
+// touching Black Pawns (8 bits each), the Qi sums of the White Pawns and of
+// the Black Pawns (16 bits each) and RELQI for White (16 bits, signed).
+static uint64_t pawn_data(position_t* p) {
+  uint64_t pawns = (p->piece_loc[BLACK] | p->piece_loc[WHITE]) & ~p->monarchs;
+  uint64_t touching = pawns & neighbors_of(pawns);
+  uint64_t data = 0;
+  data |= (uint64_t)__builtin_popcountll(pawns_of(p, WHITE) & touching);
+  data |= (uint64_t)__builtin_popcountll(pawns_of(p, BLACK) & touching) << 8;
+  data |= (uint64_t)(abs_qi(p, WHITE) / PAWN_EV_VALUE) << 16;
+  data |= (uint64_t)(abs_qi(p, BLACK) / PAWN_EV_VALUE) << 32;
+  data |= (uint64_t)(uint16_t)rel_qi(p) << 48;
+  return data;
+}
+
+// Fills in PTOUCH, RELQI and ABSQI from the Pawn hash table, working them out
+// and storing them on a miss.
+static void pawn_terms(position_t* p, ev_score_t score[2][NUM_HEURISTICS]) {
+  uint64_t data;
+
+  if (pawn_hash == NULL) {
+    data = pawn_data(p);
+  } else {
+    pawnHashEntry_t* entry = &pawn_hash[p->pawn_key & pawn_hash_mask];
+    uint64_t check = entry->check;
+    data = entry->data;
+    evalStats_t* stats = my_eval_stats();
+    if ((check ^ data) == p->pawn_key) {
+      stats->pawn_hits++;
+      tbassert(data == pawn_data(p),
+               "Pawn hash entry %" PRIx64 ", Pawns %" PRIx64 "\n", data,
+               pawn_data(p));
+    } else {
+      stats->pawn_misses++;
+      data = pawn_data(p);
+      entry->check = p->pawn_key ^ data;
+      entry->data = data;
+    }
+  }
+
+  score[WHITE][PTOUCH] = -(ev_score_t)(data & 0xFF);
+  score[BLACK][PTOUCH] = -(ev_score_t)((data >> 8) & 0xFF);
+  score[WHITE][ABSQI] = (ev_score_t)((data >> 16) & 0xFFFF) * PAWN_EV_VALUE;
+  score[BLACK][ABSQI] = (ev_score_t)((data >> 32) & 0xFFFF) * PAWN_EV_VALUE;
+  score[WHITE][RELQI] = (int16_t)(data >> 48);
+  score[BLACK][RELQI] = -score[WHITE][RELQI];
+}
+
+void pawn_hash_resize(int size_in_meg) {
+  free(pawn_hash);
+  pawn_hash = NULL;
+  pawn_hash_mask = 0;
+  if (size_in_meg <= 0) {
+    return;
+  }
+
+  uint64_t num_of_entries = 1;
+  while (2 * num_of_entries * sizeof(pawnHashEntry_t) <=
+         (uint64_t)size_in_meg << 20) {
+    num_of_entries *= 2;
+  }
+  pawn_hash = (pawnHashEntry_t*)malloc(num_of_entries * sizeof(pawnHashEntry_t));
+  if (pawn_hash == NULL) {
+    fprintf(stderr, "Pawn hash table too big\n");
+    exit(1);
+  }
+  pawn_hash_mask = num_of_entries - 1;
+  pawn_hash_clear();
+}
+
+void pawn_hash_clear() {
+  if (pawn_hash) {
+    memset(pawn_hash, 0, (pawn_hash_mask + 1) * sizeof(pawnHashEntry_t));
+  }
+}
+
+size_t pawn_hash_num_of_entries() {
+  return pawn_hash ? pawn_hash_mask + 1 : 0;
+}
+
+void pawn_hash_get_stats(uint64_t* hits, uint64_t* misses) {
+  *hits = 0;
+  *misses = 0;
+  for (int i = 0; i < EVAL_STAT_SLOTS; i++) {
+    *hits += eval_stats[i].pawn_hits;
+    *misses += eval_stats[i].pawn_misses;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Static evaluation
+// -----------------------------------------------------------------------------
+
+// Every heuristic's score for both colors, from the incremental sums and
+// the Pawn hash table, or, if verbose, recomputed and printed piece by piece
+static void heuristic_scores(position_t* p, ev_score_t score[2][NUM_HEURISTICS],
+                             bool verbose) {
+  if (verbose) {
+    eval_pieces(p, score, true);
+  } else {
+    eval_acc(p, score);
+    pawn_terms(p, score);
+  }
+
+  #ifndef NDEBUG
+    ev_score_t full[2][NUM_HEURISTICS] = {{0}};
+    eval_pieces(p, full, false);
+    for (color_t c = 0; c <= 1; c++) {
+      for (int i = 0; i < NUM_HEURISTICS; i++) {
+        tbassert(score[c][i] == full[c][i],
+                 "%s for %s: incremental %d, recomputed %d\n",
+                 heuristic_strs[i], color_to_str(c), score[c][i], full[c][i]);
+      }
+    }
+  #endif
+
+  // LCOVERAGE heuristic
+  score[WHITE][LCOVERAGE] = lcoverage(p, WHITE);
+  score[BLACK][LCOVERAGE] = lcoverage(p, BLACK);
+}
+
+// Weighs the heuristic scores of both colors into a score from the point of
+// view of the side to move
+static score_t weigh(position_t* p, ev_score_t score[2][NUM_HEURISTICS],
+                     bool verbose) {
+  // White's lead in each heuristic, weighted, summed in units of
+  // 1 / PAWN_EV_VALUE of an ev_score_t and scaled back down only once
+  int64_t tot = 0;
+  for (int i = 0; i < NUM_HEURISTICS; i++) {
+    int64_t unit = ev_scaled_heuristics[i] ? 1 : PAWN_EV_VALUE;
+    tot += (int64_t)(score[WHITE][i] - score[BLACK][i]) *
+           *heuristic_weights[i] * unit;
+
+    if (verbose) {
+      for (color_t c = 0; c <= 1; c++) {
+        printf("Total %s score of %d for %s\n", heuristic_strs[i],
+               score[c][i], color_to_str(c));
+        printf("Final %s contribution of %d for %s\n", heuristic_strs[i],
+               (ev_score_t)((int64_t)score[c][i] * *heuristic_weights[i] *
+                            unit / PAWN_EV_VALUE),
                color_to_str(c));
       }
     }
   }
 
-  ev_score_t tot = total_score[WHITE] - total_score[BLACK];
-
   if (color_to_move_of(p) == BLACK) {
     tot = -tot;
   }
 
-  return tot / EV_SCORE_RATIO;
-}
\ No newline at end of file
+  return tot / (PAWN_EV_VALUE * EV_SCORE_RATIO);
+}
+
+// Static evaluation.  Returns score
+score_t eval(position_t* p, bool verbose) {
+  // seed rand_r with a value of 1, as per
+  // https://linux.die.net/man/3/rand_r
+  // static __thread unsigned int seed = 1; //not using RANDOMIZE
+
+  if (USE_NNUE) {
+    score_t score = nnue_eval(p);
+    if (verbose) {
+      printf("Network score of %d for %s\n", score,
+             color_to_str(color_to_move_of(p)));
+    }
+    return score;
+  }
+
+  // verbose = true: print out components of score
+  ev_score_t score[2][NUM_HEURISTICS] = {0};
+  heuristic_scores(p, score, verbose);
+  return weigh(p, score, verbose);
+}
+
+double eval_feature_scale(int i) {
+  int64_t unit = ev_scaled_heuristics[i] ? 1 : PAWN_EV_VALUE;
+  return (double)unit / (PAWN_EV_VALUE * EV_SCORE_RATIO);
+}
+
+void eval_features(position_t* p, int32_t out[NUM_HEURISTICS]) {
+  ev_score_t score[2][NUM_HEURISTICS] = {0};
+  heuristic_scores(p, score, false);
+  for (int i = 0; i < NUM_HEURISTICS; i++) {
+    out[i] = score[WHITE][i] - score[BLACK][i];
+  }
+}
+// -----------------------------------------------------------------------------
+// Evaluation cache
+// -----------------------------------------------------------------------------
+
+int EVAL_CACHE;  // eval cache size in MBytes; 0 disables it
+
+// Static scores keyed on Zobrist key, shared by all workers.  An entry packs
+// the key's high 48 bits with the 16-bit score, so it is read and written as
+// one word without locking and can never be torn; the low bits of the key
+// pick the entry.  Scores depend on the evaluation weights, so the cache is
+// cleared whenever an option changes.
+//
+// https://www.chessprogramming.org/Evaluation_Hash_Table
+#define EVAL_CACHE_SCORE_BITS 16
+#define EVAL_CACHE_SCORE_MASK ((1ULL << EVAL_CACHE_SCORE_BITS) - 1)
+
+static uint64_t* eval_cache = NULL;
+static uint64_t eval_cache_mask = 0;
+
+void eval_cache_resize(int size_in_meg) {
+  free(eval_cache);
+  eval_cache = NULL;
+  eval_cache_mask = 0;
+  if (size_in_meg <= 0) {
+    return;
+  }
+
+  uint64_t num_of_entries = 1;
+  while (2 * num_of_entries * sizeof(uint64_t) <=
+         (uint64_t)size_in_meg << 20) {
+    num_of_entries *= 2;
+  }
+  eval_cache = (uint64_t*)malloc(num_of_entries * sizeof(uint64_t));
+  if (eval_cache == NULL) {
+    fprintf(stderr, "Eval cache too big\n");
+    exit(1);
+  }
+  eval_cache_mask = num_of_entries - 1;
+  eval_cache_clear();
+}
+
+void eval_cache_clear() {
+  if (eval_cache) {
+    memset(eval_cache, 0, (eval_cache_mask + 1) * sizeof(uint64_t));
+  }
+}
+
+size_t eval_cache_num_of_entries() {
+  return eval_cache ? eval_cache_mask + 1 : 0;
+}
+
+void eval_cache_get_stats(uint64_t* hits, uint64_t* misses) {
+  *hits = 0;
+  *misses = 0;
+  for (int i = 0; i < EVAL_STAT_SLOTS; i++) {
+    *hits += eval_stats[i].hits;
+    *misses += eval_stats[i].misses;
+  }
+}
+
+// Starts loading the entry eval_cached() will look at for key
+__attribute__((always_inline)) void eval_cache_prefetch(uint64_t key) {
+  if (eval_cache) {
+    __builtin_prefetch(&eval_cache[key & eval_cache_mask]);
+  }
+}
+
+score_t eval_cached(position_t* p) {
+  if (eval_cache == NULL) {
+    return eval(p, false);
+  }
+
+  uint64_t* entry = &eval_cache[p->key & eval_cache_mask];
+  uint64_t tag = p->key & ~EVAL_CACHE_SCORE_MASK;
+  uint64_t data = *entry;
+  evalStats_t* stats = my_eval_stats();
+
+  if ((data & ~EVAL_CACHE_SCORE_MASK) == tag) {
+    stats->hits++;
+    score_t score = (score_t)(uint16_t)(data & EVAL_CACHE_SCORE_MASK);
+    tbassert(score == eval(p, false), "cached eval %d, eval %d\n", score,
+             eval(p, false));
+    return score;
+  }
+
+  stats->misses++;
+  score_t score = eval(p, false);
+  *entry = tag | (uint16_t)score;
+  return score;
+}
+
+// -----------------------------------------------------------------------------
+// Lazy evaluation
+// -----------------------------------------------------------------------------
+
+// The terms PTOUCH, RELQI, ABSQI and LCOVERAGE are left out of the estimate;
+// margin is what they are taken to be worth at most.
+//
+// https://www.chessprogramming.org/Lazy_Evaluation
+score_t eval_lazy(position_t* p, score_t alpha, score_t beta, score_t margin) {
+  evalStats_t* stats = my_eval_stats();
+
+  // The accumulated terms say nothing about the network's score
+  if (margin > 0 && !USE_NNUE) {
+    ev_score_t score[2][NUM_HEURISTICS] = {{0}};
+    eval_acc(p, score);
+    score_t estimate = weigh(p, score, false);
+    if (estimate - margin >= beta) {
+      stats->lazy_fast++;
+      return estimate - margin;
+    }
+    if (estimate + margin <= alpha) {
+      stats->lazy_fast++;
+      return estimate + margin;
+    }
+  }
+
+  stats->lazy_full++;
+  return eval_cached(p);
+}
+
+void eval_lazy_get_stats(uint64_t* fast, uint64_t* full) {
+  *fast = 0;
+  *full = 0;
+  for (int i = 0; i < EVAL_STAT_SLOTS; i++) {
+    *fast += eval_stats[i].lazy_fast;
+    *full += eval_stats[i].lazy_full;
+  }
+}
@@ -4,6 +4,7 @@
 #define EVAL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "move_gen.h"
 #include "search.h"
@@ -21,8 +22,70 @@
 // shorter version of PAWN_EV_VALUE to fit in table
 #define P_EV_VAL PAWN_EV_VALUE
 
+// Terms of the static evaluation, each with a weight in options.h (PMAT, the
+// unit, excepted)
+enum heuristics_t {
+  PTOUCH,
+  PPROX,
+  MFACE,
+  MCEDE,
+  LCOVERAGE,
+  PMID,
+  MMID,
+  PMAT,
+  RELQI,
+  ABSQI,
+  NUM_HEURISTICS
+};
+
 score_t eval(position_t* p, bool verbose);
 
+// White's lead in each heuristic, unweighted: what eval() multiplies by the
+// weights of options.h before it sums them.  The heuristics are scored
+// whether or not use_nnue is set.  For tuning the weights.
+void eval_features(position_t* p, int32_t out[NUM_HEURISTICS]);
+
+// Names and weights of the heuristics: &PTOUCH_weight and so on, as set by
+// the options of the same names (PMAT has none; it is the unit)
+extern char* heuristic_strs[NUM_HEURISTICS];
+extern int* const heuristic_weights[NUM_HEURISTICS];
+// Centipawns for White that a unit of eval_features()[i] is worth per unit of
+// its weight: eval() is the sum of the features times their weights times
+// these, rounded toward zero, from the side to move's point of view
+double eval_feature_scale(int i);
+
+// Cache of eval(p, false) by Zobrist key, sized by the evalcache option
+score_t eval_cached(position_t* p);
+__attribute__((always_inline)) void eval_cache_prefetch(uint64_t key);
+void eval_cache_resize(int size_in_meg);
+void eval_cache_clear();
+size_t eval_cache_num_of_entries();
+void eval_cache_get_stats(uint64_t* hits, uint64_t* misses);
+
+// Bound on eval_cached(p) for a search that only needs to know how it compares
+// with the window (alpha, beta).  A score <= alpha is an upper bound and one
+// >= beta a lower bound; a score in between is exact.  An estimate from the
+// accumulated terms settles the node when it is more than margin outside the
+// window, and the full evaluation is done only otherwise.  margin <= 0 always
+// does the full evaluation.
+score_t eval_lazy(position_t* p, score_t alpha, score_t beta, score_t margin);
+void eval_lazy_get_stats(uint64_t* fast, uint64_t* full);
+
+// Cache of the Pawn terms by Pawn key, sized by the pawnhash option
+void pawn_hash_resize(int size_in_meg);
+void pawn_hash_clear();
+size_t pawn_hash_num_of_entries();
+void pawn_hash_get_stats(uint64_t* hits, uint64_t* misses);
+
+// Zeroes the counts of eval_cache_get_stats(), pawn_hash_get_stats() and
+// eval_lazy_get_stats()
+void eval_reset_stats();
+
+// Sums p->acc from scratch, for a position set up square by square
+void eval_acc_init(position_t* p);
+// Updates p->acc for the move make_move() just made and recorded in u
+void eval_acc_update(position_t* p, const undo_t* u);
+
 // test routine for p_touch()
 void test_ptouch(position_t* p);
 
@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "eval.h"
+#include "nnue.h"
 #include "tbassert.h"
 
 const char* STARTPOS_FEN =
@@ -42,7 +44,9 @@ static int parse_fen_board(position_t* p, const char* fen) {
 
   // Loop also breaks internally if (f, r) == (BOARD_WIDTH-1, 0)
   while ((c = fen[c_count++]) != '\0') {
-    piece_t* piece;
+    piece_t cell = NULL_PIECE;
+    piece_t* piece = NULL;
+    square_t piece_sq = 0;
 
     switch (c) {
       // ignore whitespace until the end
@@ -74,7 +78,6 @@ static int parse_fen_board(position_t* p, const char* fen) {
             fen_error(fen, c_count, "Too many squares in rank.\n");
             return 0;
           }
-          set_ptype(&p->board[square_of(f, r)], EMPTY);
           c--;
         }
         break;
@@ -87,16 +90,16 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         square_t white_sq = square_of(f, r);
-        piece = &(p->board[white_sq]);
+        piece = &cell;
+        piece_sq = white_sq;
         set_color(piece, WHITE);
-        p->piece_loc[WHITE] |= sq_to_bitmask[white_sq];
 
         if (next_c == 'N') {  // White Monarch facing North
           if (white_monarch_count > 1) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[WHITE][white_monarch_count++] = white_sq;
+          white_monarch_count++;
           set_ori(piece, NN);
           set_ptype(piece, MONARCH);
         } else if (next_c == 'W') {  // White Pawn facing NW
@@ -118,16 +121,16 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         square_t black_sq = square_of(f, r);
-        piece = &(p->board[black_sq]);
+        piece = &cell;
+        piece_sq = black_sq;
         set_color(piece, BLACK);
-        p->piece_loc[BLACK] |= sq_to_bitmask[black_sq];
 
         if (next_c == 'n') {  // Black Monarch facing North
           if (black_monarch_count > 1) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[BLACK][black_monarch_count++] = black_sq;
+          black_monarch_count++;
           set_ori(piece, NN);
           set_ptype(piece, MONARCH);
         } else if (next_c == 'w') {  // Black Pawn facing NW
@@ -149,16 +152,16 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         white_sq = square_of(f, r);
-        piece = &(p->board[white_sq]);
+        piece = &cell;
+        piece_sq = white_sq;
         set_color(piece, WHITE);
-        p->piece_loc[WHITE] |= sq_to_bitmask[white_sq];
 
         if (next_c == 'S') {  // White Monarch facing SOUTH
           if (white_monarch_count > 1) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[WHITE][white_monarch_count++] = white_sq;
+          white_monarch_count++;
           set_ori(piece, SS);
           set_ptype(piece, MONARCH);
         } else if (next_c == 'W') {  // White Pawn facing SW
@@ -180,16 +183,16 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         black_sq = square_of(f, r);
-        piece = &(p->board[black_sq]);
+        piece = &cell;
+        piece_sq = black_sq;
         set_color(piece, BLACK);
-        p->piece_loc[BLACK] |= sq_to_bitmask[black_sq];
 
         if (next_c == 's') {  // Black Monarch facing South
           if (black_monarch_count > 1) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[BLACK][black_monarch_count++] = black_sq;
+          black_monarch_count++;
           set_ori(piece, SS);
           set_ptype(piece, MONARCH);
         } else if (next_c == 'w') {  // Black Pawn facing SW
@@ -211,7 +214,8 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         white_sq = square_of(f, r);
-        piece = &(p->board[white_sq]);
+        piece = &cell;
+        piece_sq = white_sq;
 
 
         if (next_c == 'E') {  // White Monarch facing East
@@ -219,11 +223,10 @@ static int parse_fen_board(position_t* p, const char* fen) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[WHITE][white_monarch_count++] = white_sq;
+          white_monarch_count++;
           set_ptype(piece, MONARCH);
           set_color(piece, WHITE);
           set_ori(piece, EE);
-          p->piece_loc[WHITE] |= sq_to_bitmask[white_sq];
         } else {
           fen_error(fen, c_count + 1, "Syntax error");
           return 0;
@@ -237,7 +240,8 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         white_sq = square_of(f, r);
-        piece = &(p->board[white_sq]);
+        piece = &cell;
+        piece_sq = white_sq;
 
 
         if (next_c == 'W') {  // White Monarch facing West
@@ -245,11 +249,10 @@ static int parse_fen_board(position_t* p, const char* fen) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[WHITE][white_monarch_count++] = white_sq;
+          white_monarch_count++;
           set_ptype(piece, MONARCH);
           set_color(piece, WHITE);
           set_ori(piece, WW);
-          p->piece_loc[WHITE] |= sq_to_bitmask[white_sq];
         } else {
           fen_error(fen, c_count + 1, "Syntax error");
           return 0;
@@ -263,7 +266,8 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         black_sq = square_of(f, r);
-        piece = &(p->board[black_sq]);
+        piece = &cell;
+        piece_sq = black_sq;
 
 
         if (next_c == 'e') {  // Black Monarch facing East
@@ -271,11 +275,10 @@ static int parse_fen_board(position_t* p, const char* fen) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[BLACK][black_monarch_count++] = black_sq;
+          black_monarch_count++;
           set_ptype(piece, MONARCH);
           set_color(piece, BLACK);
           set_ori(piece, EE);
-          p->piece_loc[BLACK] |= sq_to_bitmask[black_sq];
         } else {
           fen_error(fen, c_count + 1, "Syntax error");
           return 0;
@@ -289,7 +292,8 @@ static int parse_fen_board(position_t* p, const char* fen) {
         }
         next_c = fen[c_count++];
         black_sq = square_of(f, r);
-        piece = &(p->board[black_sq]);
+        piece = &cell;
+        piece_sq = black_sq;
 
 
         if (next_c == 'w') {  // Black Monarch facing West
@@ -297,11 +301,10 @@ static int parse_fen_board(position_t* p, const char* fen) {
             fen_error(fen, c_count, "Too many white monarchs");
             return 0;
           }
-          p->monarch_loc[BLACK][black_monarch_count++] = black_sq;
+          black_monarch_count++;
           set_ptype(piece, MONARCH);
           set_color(piece, BLACK);
           set_ori(piece, WW);
-          p->piece_loc[BLACK] |= sq_to_bitmask[black_sq];
         } else {
           fen_error(fen, c_count + 1, "Syntax error");
           return 0;
@@ -327,6 +330,10 @@ static int parse_fen_board(position_t* p, const char* fen) {
         return 0;
         break;
     }  // end switch
+
+    if (piece) {
+      place_piece(p, piece_sq, *piece);
+    }
   }    // end while
 
   if ((f == BOARD_WIDTH - 1) && (r == 0)) {
@@ -351,12 +358,12 @@ static int get_sq_from_str(const char* fen, int* c_count, square_t* sq) {
   }
 
   if (c == '\0') {
-    *sq = 0;
+    *sq = BOARD_SIZE;  // every real square is a valid bit index, so use one past
     return 0;
   }
 
   // get file and rank
-  if ((c - 'a' < 0) || (c - 'a') > BOARD_WIDTH) {
+  if ((c - 'a' < 0) || (c - 'a') >= BOARD_WIDTH) {
     fen_error(fen, *c_count, "Illegal specification of last move");
     return 1;
   }
@@ -366,7 +373,7 @@ static int get_sq_from_str(const char* fen, int* c_count, square_t* sq) {
     fen_error(fen, *c_count, "FEN ended before last move fully specified");
   }
 
-  if ((next_c - '0' < 0) || (next_c - '0') > BOARD_WIDTH) {
+  if ((next_c - '0' < 0) || (next_c - '0') >= BOARD_WIDTH) {
     fen_error(fen, *c_count, "Illegal specification of last move");
     return 1;
   }
@@ -378,7 +385,8 @@ static int get_sq_from_str(const char* fen, int* c_count, square_t* sq) {
 // Translate a fen string into a board position struct
 // Returns 1 if there is an error
 int fen_to_pos(position_t* p, const char* fen) {
-  static position_t dmy1, dmy2;
+  static undo_t dmy1, dmy2;
+  static repHistory_t reps;  // keys of the game played from this position
 
   // these sentinels simplify checking previous
   // states without stepping past null pointers.
@@ -392,51 +400,30 @@ int fen_to_pos(position_t* p, const char* fen) {
   // dmy2.victims = 0;
   dmy2.history = &dmy1;
 
-  p->key = 0;            // hash key
-  p->victims.count = 0;  // piece destroyed by shooter
-  p->history = &dmy2;    // history
-  p->was_played = true;  // mark position as played
+  p->key = 0;                 // hash key
+  p->cold.victims.count = 0;  // piece destroyed by shooter
+  p->cold.history = &dmy2;    // history
+  p->cold.was_played = true;  // mark position as played
   p->nply_since_victim = 0;
-  //Initialize the piece loc of both color to be 0
+  // Initialize the bitboards: every square starts out empty
   p->piece_loc[WHITE] = 0;
   p->piece_loc[BLACK] = 0;
+  p->monarchs = 0;
+  p->ori_bits[0] = 0;
+  p->ori_bits[1] = 0;
   //Initialize the removed victims
-  p->victims.removed_color[WHITE] = false;
-  p->victims.removed_color[BLACK] = false;
+  p->cold.victims.removed_color[WHITE] = false;
+  p->cold.victims.removed_color[BLACK] = false;
 
   int c_count = 0;  // Invariant: fen[c_count] is next char to be read
 
-  for (int i = 0; i < ARR_SIZE; ++i) {
-    p->board[i] = NULL_PIECE;
-    set_ptype(&p->board[i], INVALID);  // squares are invalid until filled
-  }
-
   c_count = parse_fen_board(p, fen);
   if (c_count <= 0) {
     return 1;  // parse error
   }
 
-  // p->laser_map[WHITE] = 0;
-  // p->laser_map[BLACK] = 0;
-  // #pragma clang loop unroll(full)
-  // for (int c = 0; c < 2; c ++) {
-  //   for (int m = 0; m < MAX_MONARCHS; m ++) {
-  //     mark_laser_map(p, c, p->monarch_loc[c][m]);
-  //   }
-  // }
-
-  int monarchs[2] = {0, 0};
-
-  for (fil_t f = 0; f < BOARD_WIDTH; ++f) {
-    for (rnk_t r = 0; r < BOARD_WIDTH; ++r) {
-      square_t sq = square_of(f, r);
-      piece_t x = p->board[sq];
-      ptype_t typ = ptype_of(x);
-      if (typ == MONARCH) {
-        monarchs[color_of(x)]++;
-      }
-    }
-  }
+  int monarchs[2] = {__builtin_popcountll(monarchs_of(p, WHITE)),
+                     __builtin_popcountll(monarchs_of(p, BLACK))};
 
   if (monarchs[WHITE] == 0) {
     fen_error(fen, c_count, "No White Monarchs");
@@ -483,16 +470,24 @@ int fen_to_pos(position_t* p, const char* fen) {
     }
   }
 
+  update_lasers(p);
+  eval_acc_init(p);
+  p->pawn_key = compute_pawn_key(p);
+  if (USE_NNUE) {
+    nnue_refresh(p);
+  }
+
   // Look for last move, if it exists
   square_t lm_from_sq, lm_to_sq;
   rot_t lm_rot;
   if (get_sq_from_str(fen, &c_count, &lm_from_sq) != 0) {  // parse error
     return 1;
   }
-  if (lm_from_sq == 0) {       // from-square of last move
-    p->last_move = NULL_MOVE;  // no last move specified
+  if (lm_from_sq == BOARD_SIZE) {  // from-square of last move
+    p->last_move = NULL_MOVE;       // no last move specified
     p->key = compute_zob_key(p);
-    // update_piece_loc(p);
+    p->sym_key = compute_sym_key(p);
+    rep_history_init(p, &reps);
     return 0;
   }
 
@@ -521,6 +516,8 @@ int fen_to_pos(position_t* p, const char* fen) {
   }
   p->last_move = move_of(EMPTY, lm_rot, lm_from_sq, lm_to_sq);
   p->key = compute_zob_key(p);
+  p->sym_key = compute_sym_key(p);
+  rep_history_init(p, &reps);
   return 0;  // everything is okay
 }
 
@@ -548,11 +545,8 @@ void pos_to_fen(position_t* p, char* fen) {
     int empty_in_a_row = 0;
     for (fil_t f = 0; f < BOARD_WIDTH; ++f) {
       square_t sq = square_of(f, r);
-      ptype_t sq_type = ptype_of(p->board[sq]);
-
-      if (sq_type == INVALID) {     // invalid square
-        tbassert(false, "Bad news, yo.\n");  // This is bad!
-      }
+      piece_t x = piece_at(p, sq);
+      ptype_t sq_type = ptype_of(x);
 
       if (sq_type == EMPTY) {  // empty square
         empty_in_a_row++;
@@ -563,10 +557,10 @@ void pos_to_fen(position_t* p, char* fen) {
         }
         empty_in_a_row = 0;
 
-        color_t c = color_of(p->board[sq]);
+        color_t c = color_of(x);
 
         if (sq_type == MONARCH) {
-          int ori = ori_of(p->board[sq]);
+          int ori = ori_of(x);
           for (i = 0; i < 2; i++) {
             fen[pos++] = monarch_ori_to_rep[c][ori][i];
           }
@@ -574,7 +568,7 @@ void pos_to_fen(position_t* p, char* fen) {
         }
 
         if (sq_type == PAWN) {
-          int ori = ori_of(p->board[sq]);
+          int ori = ori_of(x);
           for (i = 0; i < 2; i++) {
             fen[pos++] = pawn_ori_to_rep[c][ori][i];
           }
@@ -0,0 +1,124 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Writes eval_tables.h, the square-to-square tables of the static evaluator,
+// to stdout.  Run by the Makefile before eval.c is compiled.
+//
+// Every entry is worked out in integer arithmetic, so the tables, and the
+// evaluator built on them, come out the same whatever floating-point flags
+// the engine is compiled with.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "eval.h"
+#include "move_gen.h"
+
+// h_dist() is 1/(|dx|+1) + 1/(|dy|+1); both terms are whole multiples of
+// 1/H_DIST_ONE, which all of 1/1 .. 1/BOARD_WIDTH divide.
+#define H_DIST_ONE 840
+
+static int fil(int sq) { return (sq >> FIL_SHIFT) & FIL_MASK; }
+static int rnk(int sq) { return (sq >> RNK_SHIFT) & RNK_MASK; }
+
+// PPROX: harmonic-ish distance between a Pawn on a and a Monarch on b, in
+// units of 1/H_DIST_ONE
+static int h_dist(int a, int b) {
+  return H_DIST_ONE / (abs(fil(a) - fil(b)) + 1) +
+         H_DIST_ONE / (abs(rnk(a) - rnk(b)) + 1);
+}
+
+// MFACE: bonus for a Monarch on sq with orientation ori facing a Monarch on
+// opp_sq, a Pawn's worth per square of the distance it faces toward the
+// other, divided by the distance between them
+static int mface(int sq, int opp_sq, int ori) {
+  int delta_fil = fil(opp_sq) - fil(sq);
+  int delta_rnk = rnk(opp_sq) - rnk(sq);
+  int dist = abs(delta_fil) + abs(delta_rnk);
+  if (dist == 0) {
+    return 0;  // two Monarchs never share a square
+  }
+  int bonus = 0;
+  switch ((monarch_ori_t)ori) {
+    case NN:
+      bonus = delta_rnk;
+      break;
+    case EE:
+      bonus = delta_fil;
+      break;
+    case SS:
+      bonus = -delta_rnk;
+      break;
+    case WW:
+      bonus = -delta_fil;
+      break;
+  }
+  return bonus * PAWN_EV_VALUE / dist;
+}
+
+// MCEDE: penalty for a Monarch on sq ceding the board quadrant of a Monarch
+// on opp_sq, a Pawn's worth times the fraction of the board that quadrant
+// covers
+static int mcede(int sq, int opp_sq) {
+  int f = fil(sq);
+  int r = rnk(sq);
+  int delta_fil = fil(opp_sq) - f;
+  int delta_rnk = rnk(opp_sq) - r;
+  int penalty;
+  if (delta_fil >= 0 && delta_rnk >= 0) {  // NE quadrant
+    penalty = (BOARD_WIDTH - f) * (BOARD_WIDTH - r);
+  } else if (delta_fil >= 0) {  // SE quadrant
+    penalty = (BOARD_WIDTH - f) * (r + 1);
+  } else if (delta_rnk <= 0) {  // SW quadrant
+    penalty = (f + 1) * (r + 1);
+  } else {  // NW quadrant
+    penalty = (f + 1) * (BOARD_WIDTH - r);
+  }
+  return PAWN_EV_VALUE * penalty / (BOARD_WIDTH * BOARD_WIDTH);
+}
+
+int main() {
+  printf("// Generated by gen_eval_tables.c -- do not edit\n\n");
+  printf("#ifndef EVAL_TABLES_H\n#define EVAL_TABLES_H\n\n");
+  printf("#include <stdint.h>\n\n");
+  printf("#define H_DIST_ONE %d\n\n", H_DIST_ONE);
+
+  printf("static const uint16_t h_dist_table[%d][%d] = {\n", BOARD_SIZE,
+         BOARD_SIZE);
+  for (int a = 0; a < BOARD_SIZE; a++) {
+    printf("  {");
+    for (int b = 0; b < BOARD_SIZE; b++) {
+      printf("%s%d", b ? ", " : "", h_dist(a, b));
+    }
+    printf("},\n");
+  }
+  printf("};\n\n");
+
+  printf("static const int16_t mface_table[%d][%d][%d] = {\n", BOARD_SIZE,
+         BOARD_SIZE, NUM_ORI);
+  for (int sq = 0; sq < BOARD_SIZE; sq++) {
+    printf("  {");
+    for (int opp_sq = 0; opp_sq < BOARD_SIZE; opp_sq++) {
+      printf("%s{", opp_sq ? ", " : "");
+      for (int ori = 0; ori < NUM_ORI; ori++) {
+        printf("%s%d", ori ? ", " : "", mface(sq, opp_sq, ori));
+      }
+      printf("}");
+    }
+    printf("},\n");
+  }
+  printf("};\n\n");
+
+  printf("static const int16_t mcede_table[%d][%d] = {\n", BOARD_SIZE,
+         BOARD_SIZE);
+  for (int sq = 0; sq < BOARD_SIZE; sq++) {
+    printf("  {");
+    for (int opp_sq = 0; opp_sq < BOARD_SIZE; opp_sq++) {
+      printf("%s%d", opp_sq ? ", " : "", mcede(sq, opp_sq));
+    }
+    printf("},\n");
+  }
+  printf("};\n\n");
+
+  printf("#endif  // EVAL_TABLES_H\n");
+  return 0;
+}
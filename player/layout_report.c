@@ -0,0 +1,77 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Prints the size of the structures the search touches at every node and the
+// offset of each field, with the cache line it starts on.  The layouts are
+// also pinned down by the _Static_asserts next to their definitions; this is
+// for looking at them.  Built and run by `make layout`.
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "move_gen.h"
+#include "search.h"
+
+#define STRUCT(type) print_struct(#type, sizeof(type))
+#define FIELD(type, field) \
+  print_field(#field, offsetof(type, field), sizeof(((type*)0)->field))
+
+static void print_struct(const char* name, size_t size) {
+  printf("\n%s: %zu bytes, %zu cache line(s)\n", name, size,
+         (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE);
+}
+
+static void print_field(const char* name, size_t offset, size_t size) {
+  printf("  line %zu  offset %3zu  size %4zu  %s\n", offset / CACHE_LINE_SIZE,
+         offset, size, name);
+}
+
+int main() {
+  STRUCT(position_t);
+  FIELD(position_t, piece_loc);
+  FIELD(position_t, monarchs);
+  FIELD(position_t, ori_bits);
+  FIELD(position_t, key);
+  FIELD(position_t, sym_key);
+  FIELD(position_t, ply);
+  FIELD(position_t, nply_since_victim);
+  FIELD(position_t, rep_top);
+  FIELD(position_t, last_move);
+  FIELD(position_t, acc);
+  FIELD(position_t, pawn_key);
+  FIELD(position_t, lasers);
+  FIELD(position_t, reps);
+  FIELD(position_t, cold);
+  FIELD(position_t, nnue);
+
+  STRUCT(searchNode);
+  FIELD(searchNode, parent);
+  FIELD(searchNode, position);
+  FIELD(searchNode, subpv);
+  FIELD(searchNode, killer);
+  FIELD(searchNode, best_move_history);
+  FIELD(searchNode, orig_alpha);
+  FIELD(searchNode, alpha);
+  FIELD(searchNode, beta);
+  FIELD(searchNode, best_score);
+  FIELD(searchNode, depth);
+  FIELD(searchNode, ply);
+  FIELD(searchNode, pov);
+  FIELD(searchNode, type);
+  FIELD(searchNode, quiescence);
+  FIELD(searchNode, legal_move_count);
+  FIELD(searchNode, best_move_index);
+  FIELD(searchNode, fake_color_to_move);
+  FIELD(searchNode, abort);
+
+  STRUCT(moveEvaluationResult);
+  FIELD(moveEvaluationResult, score);
+  FIELD(moveEvaluationResult, type);
+  FIELD(moveEvaluationResult, next_node);
+
+  STRUCT(undo_t);
+  STRUCT(lasers_t);
+  STRUCT(evalAcc_t);
+  STRUCT(positionCold_t);
+  STRUCT(repHistory_t);
+  return 0;
+}
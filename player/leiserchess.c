@@ -17,15 +17,18 @@
 #include <cilk/reducer.h>
 #endif
 
+#include "datagen.h"
 #include "end_game.h"
 #include "eval.h"
 #include "fen.h"
 #include "lookup.h"
 #include "move_gen.h"
+#include "nnue.h"
 #include "options.h"
 #include "search.h"
 #include "tbassert.h"
 #include "tt.h"
+#include "tune.h"
 #include "util.h"
 
 char VERSION[] = "1060";
@@ -60,8 +63,9 @@ void lower_case(char* s) {
 }
 
 // Returns victims or NO_VICTIMS if no victims or -1 if illegal move
-// makes the move described by 'mvstring'
-victims_t make_from_string(position_t* old, position_t* p,
+// makes the move described by 'mvstring' on a copy of 'old' in 'p', keeping
+// its undo record in 'u'
+victims_t make_from_string(position_t* old, position_t* p, undo_t* u,
                            const char* mvstring) {
   sortable_move_t lst[MAX_NUM_MOVES];
   move_t mv = NULL_MOVE;
@@ -82,7 +86,11 @@ victims_t make_from_string(position_t* old, position_t* p,
       break;
     }
   }
-  return (move_eq(mv, NULL_MOVE)) ? ILLEGAL() : actually_make_move(old, p, mv);
+  if (move_eq(mv, NULL_MOVE)) {
+    return ILLEGAL();
+  }
+  *p = *old;
+  return actually_make_move(p, mv, u);
 }
 
 typedef enum {
@@ -120,10 +128,11 @@ const char* try_lookup_table(position_t* p) {
   char move_list[OPEN_BOOK_DEPTH * 10] = {0};
 
   // Extract history from `p`
-  position_t* current_move = p;
+  move_t tail = p->last_move;
+  undo_t* current_move = p->cold.history;
   for (int move_index = p->ply; move_index > 0; move_index--) {
-    move_t tail = current_move->last_move;
     moves[move_index - 1] = tail;
+    tail = current_move->last_move;
     current_move = current_move->history;
   }
 
@@ -156,6 +165,49 @@ const char* try_lookup_table(position_t* p) {
   return best_move;
 }
 
+// Reports the eval cache hits and misses of the search so far
+static void print_eval_cache_stats(int depth) {
+  if (eval_cache_num_of_entries() == 0) {
+    return;
+  }
+  uint64_t hits, misses;
+  eval_cache_get_stats(&hits, &misses);
+  uint64_t lookups = hits + misses;
+  fprintf(OUT,
+          "info string evalcache depth %d hits %" PRIu64 " misses %" PRIu64
+          " hitrate %.1f%%\n",
+          depth, hits, misses, lookups ? 100.0 * hits / lookups : 0.0);
+}
+
+// Reports the Pawn hash table hits and misses of the search so far
+static void print_pawn_hash_stats(int depth) {
+  if (pawn_hash_num_of_entries() == 0) {
+    return;
+  }
+  uint64_t hits, misses;
+  pawn_hash_get_stats(&hits, &misses);
+  uint64_t lookups = hits + misses;
+  fprintf(OUT,
+          "info string pawnhash depth %d hits %" PRIu64 " misses %" PRIu64
+          " hitrate %.1f%%\n",
+          depth, hits, misses, lookups ? 100.0 * hits / lookups : 0.0);
+}
+
+// Reports how many of the static evaluations of the search so far eval_lazy()
+// settled from its estimate
+static void print_lazy_eval_stats(int depth) {
+  if (LAZY_MARGIN <= 0) {
+    return;
+  }
+  uint64_t fast, full;
+  eval_lazy_get_stats(&fast, &full);
+  uint64_t calls = fast + full;
+  fprintf(OUT,
+          "info string lazyeval depth %d fast %" PRIu64 " full %" PRIu64
+          " fastrate %.1f%%\n",
+          depth, fast, full, calls ? 100.0 * fast / calls : 0.0);
+}
+
 #define NUM_PARALLEL 128
 #ifdef PARALLEL
 int ncores=0;
@@ -181,6 +233,7 @@ best_move_with_padding best_move_history_all[NUM_PARALLEL];
 
 typedef struct {
   sortable_move_t move_list[MAX_NUM_MOVES];
+  int num_moves;
   char padding[64];
 } move_list_with_padding;
 move_list_with_padding move_list_all[NUM_PARALLEL];
@@ -223,6 +276,7 @@ void entry_point(entry_point_args* args, entry_point_ret* ret) {
   for (int i = 0; i< NUM_PARALLEL; i ++) {
     node_count_serial_all[i].node_count_serial = 0;
   }
+  eval_reset_stats();
 
   // Iterative deepening
   for (int d = 1; d <= depth; d++) {
@@ -232,12 +286,12 @@ void entry_point(entry_point_args* args, entry_point_ret* ret) {
     #ifdef PARALLEL
       cilk_for (int i = 0; i< ncores; i ++) {
         searchRoot(p, -INF, INF, d, 0, subpv, &node_count_serial_all[i].node_count_serial, OUT, i, 
-                    move_list_all[i].move_list, killer_all[i].killer, best_move_history_all[i].best_move_history);
+                    move_list_all[i].move_list, &move_list_all[i].num_moves, killer_all[i].killer, best_move_history_all[i].best_move_history, NULL);
       }
     #else
       for (int i = 0; i< 1; i ++) {
         searchRoot(p, -INF, INF, d, 0, subpv, &node_count_serial_all[i].node_count_serial, OUT, i, 
-                    move_list_all[i].move_list, killer_all[i].killer, best_move_history_all[i].best_move_history);
+                    move_list_all[i].move_list, &move_list_all[i].num_moves, killer_all[i].killer, best_move_history_all[i].best_move_history, NULL);
       }
     #endif
 
@@ -251,7 +305,9 @@ void entry_point(entry_point_args* args, entry_point_ret* ret) {
     }
 
     if (!should_abort()) {
-      // print something?
+      print_eval_cache_stats(d);
+      print_pawn_hash_stats(d);
+      print_lazy_eval_stats(d);
     } else {
       break;
     }
@@ -338,6 +394,11 @@ void UciBeginSearchMove(position_t* p, int depth, double tme, char* bms) {
 // print help messages in uci
 void help() {
   fprintf(OUT, "info eval      - Evaluate current position.\n");
+  fprintf(OUT, "info evalvec   - Print White's lead in each heuristic of the"
+              " current position,\n");
+  fprintf(OUT, "info             unweighted, on one line: PTOUCH PPROX MFACE"
+              " MCEDE LCOVERAGE\n");
+  fprintf(OUT, "info             PMID MMID PMAT RELQI ABSQI.\n");
   fprintf(OUT, "info display   - Display current board state.\n");
   fprintf(OUT, "info generate  - Generate all possible moves.\n");
   //ADDED features
@@ -390,11 +451,34 @@ void help() {
           "perft     - Output the number of possible moves up to a given"
           " depth.\n");
   fprintf(OUT, "info             Used to verify move the generator.\n");
+  fprintf(OUT,
+          "info             Also reports nodes/sec, the number of workers"
+          " and perft_hash.\n");
   fprintf(OUT, "info             Sample usage: \n");
   fprintf(OUT,
           "info "
           "                depth 3: generate all possible moves for"
           " depth 1--3\n");
+  fprintf(OUT,
+          "info "
+          "                divide 3: count the depth-3 leaves below each"
+          " move\n");
+  fprintf(OUT,
+          "info "
+          "laserbench - Time update_lasers() on the positions up to two moves"
+          " away; reports beams/sec.\n");
+  fprintf(OUT,
+          "info             With `beams`, times trace_laser() alone, one"
+          " beam at a time.\n");
+  fprintf(OUT, "info             Sample usage: \n");
+  fprintf(OUT,
+          "info "
+          "                laserbench 100000: trace every laser 100000"
+          " times\n");
+  fprintf(OUT,
+          "info "
+          "                laserbench 100000 beams: the same, beam by"
+          " beam\n");
   fprintf(OUT,
           "info "
           "position  - Set up the board using the fenstring given.  Possible"
@@ -562,13 +646,36 @@ int main(int argc, char* argv[]) {
     }
   #endif
 
-  position_t* gme = (position_t*)malloc(sizeof(position_t) * MAX_PLY_IN_GAME);
+  // position_t is cache-line aligned, which malloc() does not guarantee
+  position_t* gme;
+  if (posix_memalign((void**)&gme, CACHE_LINE_SIZE,
+                     sizeof(position_t) * MAX_PLY_IN_GAME) != 0) {
+    fprintf(stderr, "Could not allocate the game record\n");
+    return -1;
+  }
+  // gme_undo[ix] records the move from gme[ix] to gme[ix + 1]
+  undo_t* gme_undo = (undo_t*)malloc(sizeof(undo_t) * MAX_PLY_IN_GAME);
 
   setbuf(stdout, NULL);
   setbuf(stdin, NULL);
 
   OUT = stdout;
 
+  // Offline tools, which do not speak UCI
+  if (argc > 1 && strcmp(argv[1], "tune") == 0) {
+    init_options();
+    init_zob();
+    return tune_main(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "datagen") == 0) {
+    init_options();
+    init_zob();
+    tt_make_hashtable(HASH);
+    eval_cache_resize(EVAL_CACHE);
+    pawn_hash_resize(PAWN_HASH);
+    return datagen_main(argc - 2, argv + 2);
+  }
+
   if (argc > 1) {
     const char* fname = argv[1];
     IN = fopen(fname, "r");
@@ -583,6 +690,10 @@ int main(int argc, char* argv[]) {
   init_options();
   init_zob();
 
+  // Network weights for use_nnue, if there are any
+  const char* nnue_file = getenv("LEISERCHESS_NNUE");
+  nnue_load(nnue_file != NULL ? nnue_file : NNUE_DEFAULT_FILE);
+
   char** tok =
       (char**)malloc(sizeof(char*) * MAX_CHARS_IN_TOKEN * MAX_PLY_IN_GAME);
   int ix = 0;  // index of which position we are operating on
@@ -592,6 +703,8 @@ int main(int argc, char* argv[]) {
   char* istr = (char*)malloc(sizeof(char) * 24000);
 
   tt_make_hashtable(HASH);             // initial hash table
+  eval_cache_resize(EVAL_CACHE);
+  pawn_hash_resize(PAWN_HASH);
   fen_to_pos(&gme[ix], STARTPOS_FEN);  // initialize with the starting position
 
   //  Check to make sure we don't loop infinitely if we don't get input.
@@ -660,7 +773,7 @@ int main(int argc, char* argv[]) {
             }
               UciBeginSearchMove(&gme[ix], INF_DEPTH, goal, bms);
           }
-          victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], bms);
+          victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], &gme_undo[ix], bms);
           if (is_ILLEGAL(victims)) {
             fprintf(OUT, "info Illegal move %s\n", bms);
             fprintf(OUT,
@@ -716,7 +829,7 @@ int main(int argc, char* argv[]) {
         if (token_count > n + 1) {
           for (int j = n + 1; j < token_count; j++) {
             victims_t victims =
-                make_from_string(&gme[ix], &gme[ix + 1], tok[j]);
+                make_from_string(&gme[ix], &gme[ix + 1], &gme_undo[ix], tok[j]);
             if (is_ILLEGAL(victims)) {
               fprintf(OUT, "info string Move %s is illegal\n", tok[j]);
               ix = save_ix;
@@ -756,7 +869,7 @@ int main(int argc, char* argv[]) {
         }
         victims_t victims;
         for (int i = 1; i <= token_count; i ++) {
-          victims = make_from_string(&gme[ix], &gme[ix + 1], tok[i]);
+          victims = make_from_string(&gme[ix], &gme[ix + 1], &gme_undo[ix], tok[i]);
           if (is_ILLEGAL(victims)) {
           fprintf(OUT, "info Illegal move %s\n", tok[1]);
           fprintf(OUT,
@@ -780,7 +893,7 @@ int main(int argc, char* argv[]) {
       }
 
       if (strcmp(tok[0], "move") == 0) {
-        victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], tok[1]);
+        victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], &gme_undo[ix], tok[1]);
         if (token_count < 2) {  // no input
           fprintf(OUT, "info Second argument (move position) required.\n");
           continue;
@@ -907,10 +1020,40 @@ int main(int argc, char* argv[]) {
                 fprintf(OUT, "info string Total hash table size: %zu bytes\n",
                         tt_get_num_of_records() * tt_get_bytes_per_record());
               }
+              if (strcmp(name + 1, "evalcache") == 0) {
+                eval_cache_resize(EVAL_CACHE);
+                fprintf(OUT,
+                        "info string Eval cache set to %zu entries of "
+                        "%zu bytes each\n",
+                        eval_cache_num_of_entries(), sizeof(uint64_t));
+              } else {
+                // cached scores may not hold under the new setting
+                eval_cache_clear();
+              }
+              if (strcmp(name + 1, "pawnhash") == 0) {
+                pawn_hash_resize(PAWN_HASH);
+                fprintf(OUT,
+                        "info string Pawn hash table set to %zu entries of "
+                        "%zu bytes each\n",
+                        pawn_hash_num_of_entries(), 2 * sizeof(uint64_t));
+              }
               if (strcmp(name + 1, "reset_rng") == 0) {
                 fprintf(OUT, "info string reset the rng\n");
                 // if setting the random seed we need to reinit the zob
                 init_zob();
+                // ... which gives the Pawns new keys
+                pawn_hash_clear();
+              }
+              if (strcmp(name + 1, "use_nnue") == 0 && USE_NNUE) {
+                if (!nnue_loaded()) {
+                  fprintf(OUT, "info string no network weights loaded\n");
+                  USE_NNUE = 0;
+                } else {
+                  // make_move() has not kept the accumulators up to date
+                  for (int k = 0; k <= ix; k++) {
+                    nnue_refresh(&gme[k]);
+                  }
+                }
               }
               break;
             }
@@ -932,18 +1075,23 @@ int main(int argc, char* argv[]) {
           fprintf(OUT, "info Only reqquires two arguments.   Use 'help' to see valid command.\n");
           continue;
         } 
+        color_t mc;
         if (strcmp(tok[1], "white") == 0) {
-          square_t mloc0 = (&gme[ix])->monarch_loc[WHITE][0];
-          square_t mloc1 = (&gme[ix])->monarch_loc[WHITE][1];
-          fprintf(OUT, "%d - %d and %d - %d \n", fil_of(mloc0), rnk_of(mloc0), fil_of(mloc1), rnk_of(mloc1));
+          mc = WHITE;
         } 
         else if (strcmp(tok[1], "black") == 0) {
-          square_t mloc0 = (&gme[ix])->monarch_loc[BLACK][0];
-          square_t mloc1 = (&gme[ix])->monarch_loc[BLACK][1];
-          fprintf(OUT, "%d - %d and %d - %d \n", fil_of(mloc0), rnk_of(mloc0), fil_of(mloc1), rnk_of(mloc1));
+          mc = BLACK;
         } else {
           fprintf(OUT, "Wrong syntax! Use 'help' to see valid commands. \n");
+          continue;
+        }
+        const char* sep = "";
+        for (uint64_t m = monarchs_of(&gme[ix], mc); m; m &= m - 1) {
+          square_t mloc = __builtin_ctzll(m);
+          fprintf(OUT, "%s%d - %d", sep, fil_of(mloc), rnk_of(mloc));
+          sep = " and ";
         }
+        fprintf(OUT, " \n");
         continue;
       }
 
@@ -967,12 +1115,23 @@ int main(int argc, char* argv[]) {
         continue;
       }
 
+      if (strcmp(tok[0], "evalvec") == 0) {
+        int32_t features[NUM_HEURISTICS];
+        eval_features(&gme[ix], features);
+        fprintf(OUT, "evalvec");
+        for (int i = 0; i < NUM_HEURISTICS; i++) {
+          fprintf(OUT, " %" PRId32, features[i]);
+        }
+        fprintf(OUT, "\n");
+        continue;
+      }
+
       if (strcmp(tok[0], "eval") == 0) {
         if (token_count == 1) {  // evaluate current position
           score_t score = eval(&gme[ix], true);
           fprintf(OUT, "info score cp %d\n", score);
         } else {  // get and evaluate move
-          victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], tok[1]);
+          victims_t victims = make_from_string(&gme[ix], &gme[ix + 1], &gme_undo[ix], tok[1]);
           if (is_ILLEGAL(victims)) {
             fprintf(OUT, "info Illegal move\n");
           } else {
@@ -1031,6 +1190,13 @@ int main(int argc, char* argv[]) {
                                            // 4 17024694
                                            // 5 1071907988
         int depth = 5;
+        if (token_count >= 2 && strcmp(tok[1], "divide") == 0) {
+          if (token_count >= 3) {
+            depth = strtol(tok[2], (char**)NULL, 10);
+          }
+          do_perft_divide(&gme[ix], depth);
+          continue;
+        }
         if (token_count >= 2) {  // Takes a depth argument to test deeper
           depth = strtol(tok[1], (char**)NULL, 10);
         }
@@ -1038,6 +1204,16 @@ int main(int argc, char* argv[]) {
         continue;
       }
 
+      if (strcmp(tok[0], "laserbench") == 0) {  // update_lasers microbenchmark
+        int iterations = 100000;
+        if (token_count >= 2) {
+          iterations = strtol(tok[1], (char**)NULL, 10);
+        }
+        bool beams_only = token_count >= 3 && strcmp(tok[2], "beams") == 0;
+        do_laser_bench(&gme[ix], iterations, beams_only);
+        continue;
+      }
+
       if (strcmp(tok[0], "test") == 0) {
         test_ptouch(&gme[ix]);
         continue;
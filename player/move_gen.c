@@ -4,13 +4,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <string.h>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#if PARALLEL
+#include <cilk/cilk.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "end_game.h"
 #include "eval.h"
 #include "fen.h"
 #include "move_gen.h"
+#include "nnue.h"
 #include "search.h"
 #include "tbassert.h"
 #include "util.h"
@@ -23,11 +34,50 @@ const char* color_to_str(color_t c) { return color_strs[c]; }
 // Piece getters and setters (including color, ptype, orientation)
 // -----------------------------------------------------------------------------
 
-// Gets the 1st or 2nd monarch of the given color, 0 Indexed: 0 => 1st, 1 => 2nd
+// Reassembles the piece_t on sq from the bitplanes; NULL_PIECE if empty.
+__attribute__((always_inline)) piece_t piece_at(position_t* p, square_t sq) {
+  uint64_t occupied = (p->piece_loc[WHITE] | p->piece_loc[BLACK]) >> sq;
+  piece_t color = (p->piece_loc[BLACK] >> sq) & 1;
+  piece_t typ = (occupied & 1) + ((p->monarchs >> sq) & 1);
+  piece_t ori = ((p->ori_bits[0] >> sq) & 1) | (((p->ori_bits[1] >> sq) & 1) << 1);
+  return (color << COLOR_SHIFT) | (typ << PTYPE_SHIFT) | (ori << ORI_SHIFT);
+}
+
+// Puts piece on the (empty) square sq.
+__attribute__((always_inline)) void place_piece(position_t* p, square_t sq, piece_t piece) {
+  tbassert(ptype_of(piece) == PAWN || ptype_of(piece) == MONARCH,
+           "piece: %d\n", piece);
+  uint64_t bit = sq_to_bit(sq);
+  p->piece_loc[color_of(piece)] |= bit;
+  p->monarchs |= (ptype_of(piece) == MONARCH) ? bit : 0;
+  p->ori_bits[0] |= (uint64_t)(ori_of(piece) & 1) << sq;
+  p->ori_bits[1] |= (uint64_t)(ori_of(piece) >> 1) << sq;
+}
 
-//Use a bitboard representation for a quick look up
-__attribute__((always_inline)) square_t get_monarch(position_t* p, color_t c, int num) {
-  return p->monarch_loc[c][num];
+// Clears sq in every bitplane.
+__attribute__((always_inline)) void remove_piece(position_t* p, square_t sq) {
+  uint64_t mask = ~sq_to_bit(sq);
+  p->piece_loc[WHITE] &= mask;
+  p->piece_loc[BLACK] &= mask;
+  p->monarchs &= mask;
+  p->ori_bits[0] &= mask;
+  p->ori_bits[1] &= mask;
+}
+
+__attribute__((always_inline)) uint64_t monarchs_of(position_t* p, color_t c) {
+  return p->monarchs & p->piece_loc[c];
+}
+
+__attribute__((always_inline)) uint64_t pawns_of(position_t* p, color_t c) {
+  return p->piece_loc[c] & ~p->monarchs;
+}
+
+// Every square adjacent (including diagonally) to some square of bb.  A square
+// of bb is only included if another square of bb is adjacent to it.
+__attribute__((always_inline)) uint64_t neighbors_of(uint64_t bb) {
+  uint64_t vertical = ((bb << 1) & ~RNK_0_MASK) | ((bb >> 1) & ~RNK_7_MASK);
+  uint64_t column = bb | vertical;
+  return vertical | (column << BOARD_WIDTH) | (column >> BOARD_WIDTH);
 }
 
 // which color is moving next
@@ -44,8 +94,7 @@ __attribute__((always_inline)) color_t opp_color(color_t c) {
 }
 
 __attribute__((always_inline)) bool move_eq(move_t a, move_t b) {
-  return a.typ == b.typ && a.rot == b.rot && a.from_sq == b.from_sq &&
-         a.to_sq == b.to_sq;
+  return a == b;
 }
 
 __attribute__((always_inline)) bool sortable_move_seq(sortable_move_t a, sortable_move_t b) {
@@ -88,19 +137,28 @@ const char* nesw_to_str[NUM_ORI] = {"north", "east", "south", "west"};
 // NOTE: Zobrist hashing uses piece_t as an integer index into to the zob table.
 // So if you change your piece representation, you'll need to recompute what the
 // old piece representation is when indexing into the zob table to get the same
-// node counts.
-#define ZOB_ARR_SIZE (16*16)
-static uint64_t zob[ZOB_ARR_SIZE][1 << PIECE_INDEX_SIZE];
+// node counts.  Empty squares do not contribute to the key.
+//
+// zob_sym[sq][x] is zob[sym_square(sq)][sym_piece(x)]: what x on sq adds to
+// the key of the position's symmetric image.  Since the image has the other
+// side to move, zob_color is in sym_key exactly when White is to move.
+//
+// zob_pawn[sq][x] is what x on sq adds to the Pawn key: the same value for
+// every orientation of a Pawn of one color, so turning a Pawn leaves the key
+// alone, and 0 for Monarchs.
+static uint64_t zob[BOARD_SIZE][1 << PIECE_INDEX_SIZE];
+static uint64_t zob_sym[BOARD_SIZE][1 << PIECE_INDEX_SIZE];
+static uint64_t zob_pawn[BOARD_SIZE][1 << PIECE_INDEX_SIZE];
 static uint64_t zob_color;
 uint64_t myrand();
 
 uint64_t compute_zob_key(position_t* p) {
   uint64_t key = 0;
-  for (fil_t f = 0; f < BOARD_WIDTH; f++) {
-    for (rnk_t r = 0; r < BOARD_WIDTH; r++) {
-      square_t sq = square_of(f, r);
-      key ^= zob[sq][(int) p->board[sq]];
-    }
+  uint64_t pieces = p->piece_loc[WHITE] | p->piece_loc[BLACK];
+  while (pieces) {
+    square_t sq = __builtin_ctzll(pieces);
+    key ^= zob[sq][piece_at(p, sq)];
+    pieces &= pieces - 1;
   }
   if (color_to_move_of(p) == BLACK) {
     key ^= zob_color;
@@ -109,25 +167,30 @@ uint64_t compute_zob_key(position_t* p) {
   return key;
 }
 
-//ADDED functions:
-void update_piece_loc(position_t* p) {
-  uint64_t key_white = 0;
-  uint64_t key_black = 0;
-  for (fil_t file = 0; file < BOARD_WIDTH; file ++) {
-    for (rnk_t rnk = 0; rnk < BOARD_WIDTH; rnk ++) {
-      square_t sq = square_of(file, rnk);
-      piece_t piece = p->board[sq];
-      if (piece) {
-        if (color_of(piece) == WHITE) {
-          key_white |= sq_to_bitmask[sq];
-        } else {
-          key_black |= sq_to_bitmask[sq];
-        }
-      }
-    }
+uint64_t compute_sym_key(position_t* p) {
+  uint64_t key = 0;
+  uint64_t pieces = p->piece_loc[WHITE] | p->piece_loc[BLACK];
+  while (pieces) {
+    square_t sq = __builtin_ctzll(pieces);
+    key ^= zob_sym[sq][piece_at(p, sq)];
+    pieces &= pieces - 1;
+  }
+  if (color_to_move_of(p) == WHITE) {
+    key ^= zob_color;
+  }
+
+  return key;
+}
+
+uint64_t compute_pawn_key(position_t* p) {
+  uint64_t key = 0;
+  uint64_t pieces = p->piece_loc[WHITE] | p->piece_loc[BLACK];
+  while (pieces) {
+    square_t sq = __builtin_ctzll(pieces);
+    key ^= zob_pawn[sq][piece_at(p, sq)];
+    pieces &= pieces - 1;
   }
-  p->piece_loc[WHITE] = key_white;
-  p->piece_loc[BLACK] = key_black;
+  return key;
 }
 
 void init_zob() {
@@ -137,59 +200,43 @@ void init_zob() {
     }
   }
   zob_color = myrand();
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    for (int j = 0; j < (1 << PIECE_INDEX_SIZE); j++) {
+      zob_sym[i][j] = zob[sym_square(i)][sym_piece(j)];
+    }
+  }
+  // The Pawn values are borrowed from zob (those of the Pawn turned NW) rather
+  // than drawn, so that the random numbers drawn after init_zob() stay the same
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    for (int j = 0; j < (1 << PIECE_INDEX_SIZE); j++) {
+      zob_pawn[i][j] =
+          ptype_of(j) == PAWN ? zob[i][j & ~(ORI_MASK << ORI_SHIFT)] : 0;
+    }
+  }
+}
+
+// Adds or removes piece x on sq in all of p's keys.
+static inline void hash_piece(position_t* p, square_t sq, piece_t x) {
+  p->key ^= zob[sq][x];
+  p->sym_key ^= zob_sym[sq][x];
+  p->pawn_key ^= zob_pawn[sq][x];
 }
 
 // -----------------------------------------------------------------------------
 // Constant tables
 // -----------------------------------------------------------------------------
 
-static uint8_t qi_table[ARR_SIZE] = { 
-0, 0, 0, 8.0, 16.0, 16.0, 8.0, 0, 0, 0,  
-0, 0.0, 24.0, 40.0, 48.0, 48.0, 40.0, 24.0, 0.0, 0, 
-0, 24.0, 48.0, 64.0, 72.0, 72.0, 64.0, 48.0, 24.0, 0, 
-8.0, 40.0, 64.0, 80.0, 88.0, 88.0, 80.0, 64.0, 40.0, 8.0, 
-16.0, 48.0, 72.0, 88.0, 96.0, 96.0, 88.0, 72.0, 48.0, 16.0,
-16.0, 48.0, 72.0, 88.0, 96.0, 96.0, 88.0, 72.0, 48.0, 16.0, 
-8.0, 40.0, 64.0, 80.0, 88.0, 88.0, 80.0, 64.0, 40.0, 8.0,
-0, 24.0, 48.0, 64.0, 72.0, 72.0, 64.0, 48.0, 24.0, 0, 
-0, 0.0, 24.0, 40.0, 48.0, 48.0, 40.0, 24.0, 0.0, 0, 
-0, 0, 0, 8.0, 16.0, 16.0, 8.0, 0, 0, 0};
-static int8_t fil_table[ARR_SIZE] = { 
--1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, 
-0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,  
-1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 
-2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 
-3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 
-4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 
-5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 
-6.0, 6.0, 6.0, 6.0, 6.0, 6.0, 6.0, 6.0, 6.0, 6.0,
-7.0, 7.0, 7.0, 7.0, 7.0, 7.0, 7.0, 7.0, 7.0, 7.0, 
-8.0, 8.0, 8.0, 8.0, 8.0, 8.0, 8.0, 8.0, 8.0, 8.0,
-};
-static int8_t rnk_table[ARR_SIZE] = { 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
--1.0, 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 
-};
-static const uint8_t f_r_to_sq[BOARD_WIDTH][BOARD_WIDTH] = {
-  {11, 12, 13, 14, 15, 16, 17, 18},
-  {21, 22, 23, 24, 25, 26, 27, 28},
-  {31, 32, 33, 34, 35, 36, 37, 38},
-  {41, 42, 43, 44, 45, 46, 47, 48},
-  {51, 52, 53, 54, 55, 56, 57, 58},
-  {61, 62, 63, 64, 65, 66, 67, 68},
-  {71, 72, 73, 74, 75, 76, 77, 78},
-  {81, 82, 83, 84, 85, 86, 87, 88},
+static const uint8_t qi_table[BOARD_SIZE] = {
+   0, 24, 40, 48, 48, 40, 24,  0,
+  24, 48, 64, 72, 72, 64, 48, 24,
+  40, 64, 80, 88, 88, 80, 64, 40,
+  48, 72, 88, 96, 96, 88, 72, 48,
+  48, 72, 88, 96, 96, 88, 72, 48,
+  40, 64, 80, 88, 88, 80, 64, 40,
+  24, 48, 64, 72, 72, 64, 48, 24,
+   0, 24, 40, 48, 48, 40, 24,  0,
 };
 
-
 __attribute__((always_inline)) uint8_t qi_at(square_t sq) {
   uint8_t qi = qi_table[sq];
   DEBUG_LOG(1, "Qi at square %d is %d\n", sq, qi);
@@ -200,30 +247,25 @@ __attribute__((always_inline)) uint8_t qi_at(square_t sq) {
 // Squares
 // -----------------------------------------------------------------------------
 
-// For no square, use 0, which is guaranteed to be off board
 __attribute__((always_inline)) square_t square_of(fil_t f, rnk_t r) {
-  return f_r_to_sq[f][r];
+  tbassert(f >= 0 && f < BOARD_WIDTH && r >= 0 && r < BOARD_WIDTH,
+           "f: %d, r: %d\n", f, r);
+  return (f << FIL_SHIFT) | (r << RNK_SHIFT);
 }
 
 // Finds file of square
 __attribute__((always_inline)) fil_t fil_of(square_t sq) {
-  return fil_table[sq];
+  return (sq >> FIL_SHIFT) & FIL_MASK;
 }
 
 // Finds rank of square
 __attribute__((always_inline)) rnk_t rnk_of(square_t sq) {
-  return rnk_table[sq];  
+  return (sq >> RNK_SHIFT) & RNK_MASK;
 }
 
 // converts a square to string notation, returns number of characters printed
 int square_to_str(square_t sq, char* buf, size_t bufsize) {
-  fil_t f = fil_of(sq);
-  rnk_t r = rnk_of(sq);
-  if (f >= 0) {
-    return snprintf(buf, bufsize, "%c%d", 'a' + f, r);
-  } else {
-    return snprintf(buf, bufsize, "%c%d", 'z' + f + 1, r);
-  }
+  return snprintf(buf, bufsize, "%c%d", 'a' + fil_of(sq), rnk_of(sq));
 }
 
 // -----------------------------------------------------------------------------
@@ -247,7 +289,7 @@ __attribute__((always_inline)) int beam_of(int direction) {
 
 // reflect[beam_dir][pawn_orientation]
 // sentinel -1 indicates back of Pawn
-int reflect[NUM_ORI][NUM_ORI] = {
+static const int8_t reflect[NUM_ORI][NUM_ORI] = {
     // NW  NE  SE  SW
     {-1, -1, EE, WW},  // NN
     {NN, -1, -1, SS},  // EE
@@ -266,19 +308,45 @@ __attribute__((always_inline)) int reflect_of(int beam_dir, int pawn_ori) {
 // -----------------------------------------------------------------------------
 
 __attribute__((always_inline)) move_t move_of(ptype_t typ, rot_t rot, square_t from_sq, square_t to_sq) {
-  move_t mv;
-  mv.typ = typ;
-  mv.rot = rot;
-  mv.from_sq = from_sq;
-  mv.to_sq = to_sq;
-  return mv;
+  tbassert(from_sq < BOARD_SIZE && to_sq < BOARD_SIZE,
+           "from_sq: %d, to_sq: %d\n", from_sq, to_sq);
+  return (move_t)(((typ & PTYPE_MV_MASK) << PTYPE_MV_SHIFT) |
+                  ((rot & ROT_MASK) << ROT_SHIFT) |
+                  ((from_sq & FROM_MASK) << FROM_SHIFT) |
+                  ((to_sq & TO_MASK) << TO_SHIFT));
+}
+
+__attribute__((always_inline)) ptype_t ptype_mv_of(move_t mv) {
+  return (ptype_t)((mv >> PTYPE_MV_SHIFT) & PTYPE_MV_MASK);
+}
+
+__attribute__((always_inline)) square_t from_square(move_t mv) {
+  return (mv >> FROM_SHIFT) & FROM_MASK;
+}
+
+__attribute__((always_inline)) square_t to_square(move_t mv) {
+  return (mv >> TO_SHIFT) & TO_MASK;
+}
+
+__attribute__((always_inline)) rot_t rot_of(move_t mv) {
+  return (rot_t)((mv >> ROT_SHIFT) & ROT_MASK);
+}
+
+// The same move played on the symmetric image of the board.  Rotations keep
+// their sense under a half turn, so only the squares change.
+move_t sym_move(move_t mv) {
+  if (mv == NULL_MOVE) {
+    return NULL_MOVE;
+  }
+  return move_of(ptype_mv_of(mv), rot_of(mv), sym_square(from_square(mv)),
+                 sym_square(to_square(mv)));
 }
 
 // converts a move to string notation for FEN
 void move_to_str(move_t mv, char* buf, size_t bufsize) {
-  square_t f = mv.from_sq;  // from-square
-  square_t t = mv.to_sq;    // to-square
-  rot_t r = mv.rot;         // rotation
+  square_t f = from_square(mv);  // from-square
+  square_t t = to_square(mv);    // to-square
+  rot_t r = rot_of(mv);         // rotation
   const char* orig_buf = buf;
 
   buf += square_to_str(f, buf, bufsize);
@@ -309,69 +377,60 @@ void move_to_str(move_t mv, char* buf, size_t bufsize) {
 // Move generation
 // -----------------------------------------------------------------------------
 
-// Generate all moves from position p.  Returns number of moves.
-//
-// https://www.chessprogramming.org/Move_Generation
-int generate_all(position_t* p, sortable_move_t* sortable_move_list) {
+// Scalar reference generator: walks each piece's 8 directions in turn.
+// generate_all() must produce exactly the same list, in the same order.
+int generate_all_scalar(position_t* p, sortable_move_t* sortable_move_list) {
   color_t color_to_move = color_to_move_of(p);
   uint64_t pieces = p->piece_loc[color_to_move];
+  uint64_t pawns = (p->piece_loc[WHITE] | p->piece_loc[BLACK]) & ~p->monarchs;
   int move_count = 0;
 
-      while (pieces) {
-        uint64_t loc = pieces & (-pieces);//remove the least significant 1
-        square_t sq = sq_to_bit_index[__builtin_ctzll(loc)];
-        piece_t piece = p->board[sq];
-        ptype_t typ = ptype_of(piece);
-        // directions
-        for (int d = 0; d < (int)NUM_DIR; d++) {
-          compass_t dir = (compass_t)d;
-          int dest = sq + dir_of(dir);
-          ptype_t dest_type = ptype_of(p->board[dest]);
-          if (dest_type == INVALID) continue;
-          if (dest_type == MONARCH) continue;
-          if (dest_type != EMPTY &&
-              ptype_of(p->board[sq]) == dest_type &&
-              qi_at_dest_is_higher(sq, dest))
-            continue;
-
-          WHEN_DEBUG_VERBOSE(char buf[MAX_CHARS_IN_MOVE]);
-          WHEN_DEBUG_VERBOSE({
-            move_to_str(move_of(typ, (rot_t)0, sq, dest), buf,
-                        MAX_CHARS_IN_MOVE);
-            DEBUG_LOG(1, "Before: %s ", buf);
-          });
-          tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
-
-          move_t mv = move_of(typ, (rot_t)0, sq, dest);
-          sortable_move_list[move_count++] = make_sortable(mv);
-
-          WHEN_DEBUG_VERBOSE({
-            move_to_str(get_move(sortable_move_list[move_count - 1]), buf,
-                        MAX_CHARS_IN_MOVE);
-            DEBUG_LOG(1, "After: %s\n", buf);
-          });
-        }
+  while (pieces) {
+    square_t sq = __builtin_ctzll(pieces);
+    ptype_t typ = ((p->monarchs >> sq) & 1) ? MONARCH : PAWN;
+    // Destinations: adjacent squares not holding a Monarch, and for a Pawn,
+    // not a Pawn on a square of higher qi.
+    uint64_t targets = neighbors_of(sq_to_bit(sq)) & ~p->monarchs;
+    // directions
+    for (int d = 0; d < (int)NUM_DIR; d++) {
+      // Off-board destinations wrap to a square >= BOARD_SIZE or to a square
+      // that is not adjacent, so the targets mask rejects them.
+      square_t dest = sq + dir_of((compass_t)d);
+      if (dest >= BOARD_SIZE || !((targets >> dest) & 1)) continue;
+      if (typ == PAWN && ((pawns >> dest) & 1) && qi_at_dest_is_higher(sq, dest))
+        continue;
 
-        // For all non-360-degree rotations (i.e., not rot==0, which is NONE)
-        for (int rot = 1; rot < NUM_ROT; ++rot) {
-          tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
-          move_t mv = move_of(typ, (rot_t)rot, sq, sq);
-          sortable_move_list[move_count++] = make_sortable(mv);
-        }
-        pieces ^= loc; 
-      }
-  //   }
-  // }
+      WHEN_DEBUG_VERBOSE(char buf[MAX_CHARS_IN_MOVE]);
+      WHEN_DEBUG_VERBOSE({
+        move_to_str(move_of(typ, (rot_t)0, sq, dest), buf,
+                    MAX_CHARS_IN_MOVE);
+        DEBUG_LOG(1, "Before: %s ", buf);
+      });
+      tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
+
+      move_t mv = move_of(typ, (rot_t)0, sq, dest);
+      sortable_move_list[move_count++] = make_sortable(mv);
+
+      WHEN_DEBUG_VERBOSE({
+        move_to_str(get_move(sortable_move_list[move_count - 1]), buf,
+                    MAX_CHARS_IN_MOVE);
+        DEBUG_LOG(1, "After: %s\n", buf);
+      });
+    }
+
+    // For all non-360-degree rotations (i.e., not rot==0, which is NONE)
+    for (int rot = 1; rot < NUM_ROT; ++rot) {
+      tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
+      move_t mv = move_of(typ, (rot_t)rot, sq, sq);
+      sortable_move_list[move_count++] = make_sortable(mv);
+    }
+    pieces &= pieces - 1;
+  }
 
   // null move
   if (fire_lasers(p, color_to_move)) {
-    move_t mv;
-    square_t monarch_0 = p->monarch_loc[color_to_move][0];
-    square_t monarch_1 = p->monarch_loc[color_to_move][1];
-    if (ptype_of(p->board[monarch_0]) == MONARCH)
-      mv = move_of(MONARCH, (rot_t)0, monarch_0, monarch_0);
-    else
-      mv = move_of(MONARCH, (rot_t)0, monarch_1, monarch_1);
+    square_t monarch = __builtin_ctzll(monarchs_of(p, color_to_move));
+    move_t mv = move_of(MONARCH, (rot_t)0, monarch, monarch);
     sortable_move_list[move_count++] = make_sortable(mv);
   }
 
@@ -388,6 +447,178 @@ int generate_all(position_t* p, sortable_move_t* sortable_move_list) {
   return move_count;
 }
 
+#ifdef __AVX2__
+// Set-wise generator.  Instead of testing one destination at a time, the
+// pieces whose move in direction d is legal are computed for all 8 directions
+// at once, as 8 bitboards in two AVX2 registers:
+//
+//   mover & valid_src[d]                     destination is on the board,
+//         & ~(monarchs >> dir[d])            ... holds no Monarch,
+//         & ~(pawns of mover & (pawns >> dir[d]) & qi_up[d])
+//                                            ... nor, for a Pawn, a Pawn on a
+//                                                square of higher qi
+//
+// where ">> dir[d]" brings the square sq + dir[d] onto bit sq.  Each piece
+// then reads its own bit of the 8 bitboards into an 8-bit direction mask,
+// which is walked with tzcnt.  Pieces are emitted in square order and
+// directions in compass order, so the list matches generate_all_scalar().
+//
+// https://www.chessprogramming.org/Move_Generation#Bitboards
+
+// Squares from which a step in direction d stays on the board.
+static const uint64_t valid_src[NUM_DIR] = {
+    0x7f7f7f7f7f7f7f00ULL,  // NW
+    0x7f7f7f7f7f7f7f7fULL,  // N
+    0x007f7f7f7f7f7f7fULL,  // NE
+    0x00ffffffffffffffULL,  // E
+    0x00fefefefefefefeULL,  // SE
+    0xfefefefefefefefeULL,  // S
+    0xfefefefefefefe00ULL,  // SW
+    0xffffffffffffff00ULL,  // W
+};
+
+// Squares sq for which qi_at(sq + dir[d]) > qi_at(sq).
+static const uint64_t qi_up[NUM_DIR] = {
+    0x3f1f0f0703010000ULL,  // NW
+    0x0707070707070707ULL,  // N
+    0x00000103070f1f3fULL,  // NE
+    0x0000000000ffffffULL,  // E
+    0x000080c0e0f0f8fcULL,  // SE
+    0xe0e0e0e0e0e0e0e0ULL,  // S
+    0xfcf8f0e0c0800000ULL,  // SW
+    0xffffff0000000000ULL,  // W
+};
+
+// Bitboard b with every square sq + dir[d] moved onto bit sq, for the four
+// directions d held in the lanes of rshift/lshift.  Shift counts of 64 give 0,
+// so each lane takes whichever of the two shifts applies to it.
+static inline __m256i shift_from_dest(uint64_t b, __m256i rshift,
+                                      __m256i lshift) {
+  __m256i v = _mm256_set1_epi64x(b);
+  return _mm256_or_si256(_mm256_srlv_epi64(v, rshift),
+                         _mm256_sllv_epi64(v, lshift));
+}
+
+// Generate all moves from position p.  Returns number of moves.
+//
+// https://www.chessprogramming.org/Move_Generation
+int generate_all(position_t* p, sortable_move_t* sortable_move_list) {
+  color_t color_to_move = color_to_move_of(p);
+  uint64_t pieces = p->piece_loc[color_to_move];
+  uint64_t pawns = (p->piece_loc[WHITE] | p->piece_loc[BLACK]) & ~p->monarchs;
+  int move_count = 0;
+
+  // Lane i of the low half is direction i, of the high half direction i + 4
+  const __m256i rshift_lo = _mm256_setr_epi64x(64, 1, 9, 8);
+  const __m256i lshift_lo = _mm256_setr_epi64x(7, 64, 64, 64);
+  const __m256i rshift_hi = _mm256_setr_epi64x(7, 64, 64, 64);
+  const __m256i lshift_hi = _mm256_setr_epi64x(64, 1, 9, 8);
+
+  __m256i mover = _mm256_set1_epi64x(pieces);
+  __m256i mover_pawns = _mm256_set1_epi64x(pieces & ~p->monarchs);
+  __m256i legal[2];
+  for (int h = 0; h < 2; h++) {
+    __m256i rshift = h ? rshift_hi : rshift_lo;
+    __m256i lshift = h ? lshift_hi : lshift_lo;
+    __m256i valid = _mm256_loadu_si256((const __m256i*)&valid_src[4 * h]);
+    __m256i up = _mm256_loadu_si256((const __m256i*)&qi_up[4 * h]);
+    __m256i onto_monarch = shift_from_dest(p->monarchs, rshift, lshift);
+    __m256i onto_higher_pawn = _mm256_and_si256(
+        _mm256_and_si256(mover_pawns, up),
+        shift_from_dest(pawns, rshift, lshift));
+    legal[h] = _mm256_andnot_si256(
+        _mm256_or_si256(onto_monarch, onto_higher_pawn),
+        _mm256_and_si256(mover, valid));
+  }
+
+  while (pieces) {
+    square_t sq = __builtin_ctzll(pieces);
+    ptype_t typ = ((p->monarchs >> sq) & 1) ? MONARCH : PAWN;
+
+    // Bit d of dirs: whether the step in direction d is legal for this piece
+    __m256i to_sign = _mm256_set1_epi64x(63 - sq);
+    uint32_t dirs =
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_sllv_epi64(legal[0], to_sign))) |
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_sllv_epi64(legal[1], to_sign))) << 4;
+    while (dirs) {
+      int d = __builtin_ctz(dirs);
+      tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
+      move_t mv = move_of(typ, (rot_t)0, sq, sq + dir_of((compass_t)d));
+      sortable_move_list[move_count++] = make_sortable(mv);
+      dirs &= dirs - 1;
+    }
+
+    // For all non-360-degree rotations (i.e., not rot==0, which is NONE)
+    for (int rot = 1; rot < NUM_ROT; ++rot) {
+      tbassert(move_count < MAX_NUM_MOVES, "move_count: %d\n", move_count);
+      move_t mv = move_of(typ, (rot_t)rot, sq, sq);
+      sortable_move_list[move_count++] = make_sortable(mv);
+    }
+    pieces &= pieces - 1;
+  }
+
+  // null move
+  if (fire_lasers(p, color_to_move)) {
+    square_t monarch = __builtin_ctzll(monarchs_of(p, color_to_move));
+    move_t mv = move_of(MONARCH, (rot_t)0, monarch, monarch);
+    sortable_move_list[move_count++] = make_sortable(mv);
+  }
+
+#ifndef NDEBUG
+  sortable_move_t reference[MAX_NUM_MOVES];
+  int reference_count = generate_all_scalar(p, reference);
+  tbassert(reference_count == move_count, "set-wise: %d, scalar: %d\n",
+           move_count, reference_count);
+  for (int i = 0; i < move_count; i++) {
+    tbassert(move_eq(get_move(reference[i]), get_move(sortable_move_list[i])),
+             "move %d differs from the scalar generator\n", i);
+  }
+#endif
+
+  return move_count;
+}
+#else
+// Without AVX2, the reference generator is the generator
+int generate_all(position_t* p, sortable_move_t* sortable_move_list) {
+  return generate_all_scalar(p, sortable_move_list);
+}
+#endif
+
+// Whether generate_all(p) would produce mv.  Lets the search try moves from
+// the transposition table and the killer table before generating anything.
+bool is_pseudo_legal(position_t* p, move_t mv) {
+  color_t color_to_move = color_to_move_of(p);
+  square_t from_sq = from_square(mv);
+  square_t to_sq = to_square(mv);
+
+  if (from_sq >= BOARD_SIZE || to_sq >= BOARD_SIZE ||
+      !((p->piece_loc[color_to_move] >> from_sq) & 1)) {
+    return false;
+  }
+  ptype_t typ = ((p->monarchs >> from_sq) & 1) ? MONARCH : PAWN;
+  if (ptype_mv_of(mv) != typ) {
+    return false;
+  }
+
+  if (from_sq == to_sq) {
+    if (rot_of(mv) != NONE) {
+      return true;  // rotation
+    }
+    // null move: only with the first Monarch, and only while a laser hits
+    return typ == MONARCH &&
+           from_sq == __builtin_ctzll(monarchs_of(p, color_to_move)) &&
+           fire_lasers(p, color_to_move);
+  }
+
+  uint64_t targets = neighbors_of(sq_to_bit(from_sq)) & ~p->monarchs;
+  if (rot_of(mv) != NONE || !((targets >> to_sq) & 1)) {
+    return false;
+  }
+  uint64_t pawns = (p->piece_loc[WHITE] | p->piece_loc[BLACK]) & ~p->monarchs;
+  return !(typ == PAWN && ((pawns >> to_sq) & 1) &&
+           qi_at_dest_is_higher(from_sq, to_sq));
+}
+
 int generate_all_with_color(position_t* p, sortable_move_t* sortable_move_list,
                             color_t color) {
   color_t color_to_move = color_to_move_of(p);
@@ -407,83 +638,214 @@ int generate_all_with_color(position_t* p, sortable_move_t* sortable_move_list,
 // -----------------------------------------------------------------------------
 // Move execution
 // -----------------------------------------------------------------------------
-// Returns the square of piece that would be zapped by the laser if fired once,
-// or 0 if no such piece exists.
+// Returns a bitboard holding the square of the piece that would be zapped by
+// the laser if fired once, or 0 if no such piece exists.
+//
+// p  : Current board state.
+// sq : Square of the monarch shooting the laser.
 //
-// p : Current board state.
-// c : Color of monarch shooting laser.
-// n : Monarch ID
-static const uint64_t ray_in_rank[8] = {0x0101010101010101, 0x0202020202020202, 0x0404040404040404,
-                                        0x0808080808080808, 0x1010101010101010, 0x2020202020202020,
-                                        0x4040404040404040, 0x8080808080808080};
-static const uint64_t ray_in_file[8] = {0x00000000000000ff, 0x000000000000ff00, 0x0000000000ff0000,
-                                        0x00000000ff000000, 0x000000ff00000000, 0x0000ff0000000000,
-                                        0x00ff000000000000, 0xff00000000000000};   
-
-square_t fire_laser(position_t* p, square_t sq) {
-  if (ptype_of(p->board[sq]) == EMPTY || ptype_of(p->board[sq]) == INVALID)
-    return 0;
-  // uint64_t shot = sq_to_bitmask[sq];
+// beam_ray[bdir][sq] holds every square strictly beyond sq in beam direction
+// bdir, up to the edge of the board.  The first piece a beam hits is therefore
+// the nearest set bit of beam_ray & pieces: the lowest one for beams moving
+// towards higher squares (North and East), the highest one otherwise.
+//
+// https://www.chessprogramming.org/Classical_Approach
+static const uint64_t beam_ray[NUM_ORI][BOARD_SIZE] = {
+    {  // NN
+     0x00000000000000feULL, 0x00000000000000fcULL, 0x00000000000000f8ULL, 0x00000000000000f0ULL,
+     0x00000000000000e0ULL, 0x00000000000000c0ULL, 0x0000000000000080ULL, 0x0000000000000000ULL,
+     0x000000000000fe00ULL, 0x000000000000fc00ULL, 0x000000000000f800ULL, 0x000000000000f000ULL,
+     0x000000000000e000ULL, 0x000000000000c000ULL, 0x0000000000008000ULL, 0x0000000000000000ULL,
+     0x0000000000fe0000ULL, 0x0000000000fc0000ULL, 0x0000000000f80000ULL, 0x0000000000f00000ULL,
+     0x0000000000e00000ULL, 0x0000000000c00000ULL, 0x0000000000800000ULL, 0x0000000000000000ULL,
+     0x00000000fe000000ULL, 0x00000000fc000000ULL, 0x00000000f8000000ULL, 0x00000000f0000000ULL,
+     0x00000000e0000000ULL, 0x00000000c0000000ULL, 0x0000000080000000ULL, 0x0000000000000000ULL,
+     0x000000fe00000000ULL, 0x000000fc00000000ULL, 0x000000f800000000ULL, 0x000000f000000000ULL,
+     0x000000e000000000ULL, 0x000000c000000000ULL, 0x0000008000000000ULL, 0x0000000000000000ULL,
+     0x0000fe0000000000ULL, 0x0000fc0000000000ULL, 0x0000f80000000000ULL, 0x0000f00000000000ULL,
+     0x0000e00000000000ULL, 0x0000c00000000000ULL, 0x0000800000000000ULL, 0x0000000000000000ULL,
+     0x00fe000000000000ULL, 0x00fc000000000000ULL, 0x00f8000000000000ULL, 0x00f0000000000000ULL,
+     0x00e0000000000000ULL, 0x00c0000000000000ULL, 0x0080000000000000ULL, 0x0000000000000000ULL,
+     0xfe00000000000000ULL, 0xfc00000000000000ULL, 0xf800000000000000ULL, 0xf000000000000000ULL,
+     0xe000000000000000ULL, 0xc000000000000000ULL, 0x8000000000000000ULL, 0x0000000000000000ULL,
+    },
+    {  // EE
+     0x0101010101010100ULL, 0x0202020202020200ULL, 0x0404040404040400ULL, 0x0808080808080800ULL,
+     0x1010101010101000ULL, 0x2020202020202000ULL, 0x4040404040404000ULL, 0x8080808080808000ULL,
+     0x0101010101010000ULL, 0x0202020202020000ULL, 0x0404040404040000ULL, 0x0808080808080000ULL,
+     0x1010101010100000ULL, 0x2020202020200000ULL, 0x4040404040400000ULL, 0x8080808080800000ULL,
+     0x0101010101000000ULL, 0x0202020202000000ULL, 0x0404040404000000ULL, 0x0808080808000000ULL,
+     0x1010101010000000ULL, 0x2020202020000000ULL, 0x4040404040000000ULL, 0x8080808080000000ULL,
+     0x0101010100000000ULL, 0x0202020200000000ULL, 0x0404040400000000ULL, 0x0808080800000000ULL,
+     0x1010101000000000ULL, 0x2020202000000000ULL, 0x4040404000000000ULL, 0x8080808000000000ULL,
+     0x0101010000000000ULL, 0x0202020000000000ULL, 0x0404040000000000ULL, 0x0808080000000000ULL,
+     0x1010100000000000ULL, 0x2020200000000000ULL, 0x4040400000000000ULL, 0x8080800000000000ULL,
+     0x0101000000000000ULL, 0x0202000000000000ULL, 0x0404000000000000ULL, 0x0808000000000000ULL,
+     0x1010000000000000ULL, 0x2020000000000000ULL, 0x4040000000000000ULL, 0x8080000000000000ULL,
+     0x0100000000000000ULL, 0x0200000000000000ULL, 0x0400000000000000ULL, 0x0800000000000000ULL,
+     0x1000000000000000ULL, 0x2000000000000000ULL, 0x4000000000000000ULL, 0x8000000000000000ULL,
+     0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+     0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+    },
+    {  // SS
+     0x0000000000000000ULL, 0x0000000000000001ULL, 0x0000000000000003ULL, 0x0000000000000007ULL,
+     0x000000000000000fULL, 0x000000000000001fULL, 0x000000000000003fULL, 0x000000000000007fULL,
+     0x0000000000000000ULL, 0x0000000000000100ULL, 0x0000000000000300ULL, 0x0000000000000700ULL,
+     0x0000000000000f00ULL, 0x0000000000001f00ULL, 0x0000000000003f00ULL, 0x0000000000007f00ULL,
+     0x0000000000000000ULL, 0x0000000000010000ULL, 0x0000000000030000ULL, 0x0000000000070000ULL,
+     0x00000000000f0000ULL, 0x00000000001f0000ULL, 0x00000000003f0000ULL, 0x00000000007f0000ULL,
+     0x0000000000000000ULL, 0x0000000001000000ULL, 0x0000000003000000ULL, 0x0000000007000000ULL,
+     0x000000000f000000ULL, 0x000000001f000000ULL, 0x000000003f000000ULL, 0x000000007f000000ULL,
+     0x0000000000000000ULL, 0x0000000100000000ULL, 0x0000000300000000ULL, 0x0000000700000000ULL,
+     0x0000000f00000000ULL, 0x0000001f00000000ULL, 0x0000003f00000000ULL, 0x0000007f00000000ULL,
+     0x0000000000000000ULL, 0x0000010000000000ULL, 0x0000030000000000ULL, 0x0000070000000000ULL,
+     0x00000f0000000000ULL, 0x00001f0000000000ULL, 0x00003f0000000000ULL, 0x00007f0000000000ULL,
+     0x0000000000000000ULL, 0x0001000000000000ULL, 0x0003000000000000ULL, 0x0007000000000000ULL,
+     0x000f000000000000ULL, 0x001f000000000000ULL, 0x003f000000000000ULL, 0x007f000000000000ULL,
+     0x0000000000000000ULL, 0x0100000000000000ULL, 0x0300000000000000ULL, 0x0700000000000000ULL,
+     0x0f00000000000000ULL, 0x1f00000000000000ULL, 0x3f00000000000000ULL, 0x7f00000000000000ULL,
+    },
+    {  // WW
+     0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+     0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+     0x0000000000000001ULL, 0x0000000000000002ULL, 0x0000000000000004ULL, 0x0000000000000008ULL,
+     0x0000000000000010ULL, 0x0000000000000020ULL, 0x0000000000000040ULL, 0x0000000000000080ULL,
+     0x0000000000000101ULL, 0x0000000000000202ULL, 0x0000000000000404ULL, 0x0000000000000808ULL,
+     0x0000000000001010ULL, 0x0000000000002020ULL, 0x0000000000004040ULL, 0x0000000000008080ULL,
+     0x0000000000010101ULL, 0x0000000000020202ULL, 0x0000000000040404ULL, 0x0000000000080808ULL,
+     0x0000000000101010ULL, 0x0000000000202020ULL, 0x0000000000404040ULL, 0x0000000000808080ULL,
+     0x0000000001010101ULL, 0x0000000002020202ULL, 0x0000000004040404ULL, 0x0000000008080808ULL,
+     0x0000000010101010ULL, 0x0000000020202020ULL, 0x0000000040404040ULL, 0x0000000080808080ULL,
+     0x0000000101010101ULL, 0x0000000202020202ULL, 0x0000000404040404ULL, 0x0000000808080808ULL,
+     0x0000001010101010ULL, 0x0000002020202020ULL, 0x0000004040404040ULL, 0x0000008080808080ULL,
+     0x0000010101010101ULL, 0x0000020202020202ULL, 0x0000040404040404ULL, 0x0000080808080808ULL,
+     0x0000101010101010ULL, 0x0000202020202020ULL, 0x0000404040404040ULL, 0x0000808080808080ULL,
+     0x0001010101010101ULL, 0x0002020202020202ULL, 0x0004040404040404ULL, 0x0008080808080808ULL,
+     0x0010101010101010ULL, 0x0020202020202020ULL, 0x0040404040404040ULL, 0x0080808080808080ULL,
+    },
+};
+
+// bounce[bdir][code]: the direction a beam leaves a square in after hitting
+// the piece there, or -1 if the beam stops and zaps it.  code is the piece's
+// orientation, plus 4 for a Monarch (which always stops the beam), so one
+// lookup replaces both the Monarch test and reflect_of().
+static const int8_t bounce[NUM_ORI][2 * NUM_ORI] = {
+    // NW  NE  SE  SW  Monarch
+    {-1, -1, EE, WW, -1, -1, -1, -1},  // NN
+    {NN, -1, -1, SS, -1, -1, -1, -1},  // EE
+    {WW, EE, -1, -1, -1, -1, -1, -1},  // SS
+    {-1, NN, SS, -1, -1, -1, -1, -1}   // WW
+};
+
+static inline square_t first_hit(int bdir, uint64_t hit) {
+  return (bdir & 0b10) ? 63 - __builtin_clzll(hit) : __builtin_ctzll(hit);
+}
+
+// Returns a bitboard of the squares the laser of the monarch on sq passes
+// over, including sq itself and the square of the piece it stops on.  *hit
+// receives that piece's square, or BOARD_SIZE if the laser leaves the board.
+static uint64_t trace_laser(position_t* p, square_t sq, square_t* hit) {
+  tbassert((p->monarchs >> sq) & 1, "sq: %d\n", sq);
   uint64_t pieces = p->piece_loc[WHITE] | p->piece_loc[BLACK];
-  int bdir = ori_of(p->board[sq]);
-  tbassert(ptype_of(p->board[sq]) == MONARCH, "ptype: %d\n", ptype_of(p->board[sq]));
+  int bdir = ori_of(piece_at(p, sq));
+  uint64_t path = sq_to_bit(sq);
 
   while (true) {
-    uint64_t ray;
-    uint64_t shot = sq_to_bitmask[sq];
-    if (bdir & 0b01) {
-      //Shooting North or South
-      ray = ray_in_rank[rnk_of(sq)];
-    } else {
-      //Shooting West or East
-      ray = ray_in_file[fil_of(sq)];
+    uint64_t ahead = beam_ray[bdir][sq] & pieces;
+    if (ahead == 0) {
+      *hit = BOARD_SIZE;
+      return path | beam_ray[bdir][sq];
     }
-    if (bdir & 0b10) {
-      //Shooting in negative direction (towards lower files/ranks)
-      ray &= (shot-1);
-    } else {
-      //Shooting in positive direction (towards higher files/ranks)
-      ray &= -(shot*2);
+    square_t next_sq = first_hit(bdir, ahead);
+    path |= beam_ray[bdir][sq] & ~beam_ray[bdir][next_sq];
+    sq = next_sq;
+    int code = ((p->ori_bits[0] >> sq) & 1) | (((p->ori_bits[1] >> sq) & 1) << 1) |
+               (((p->monarchs >> sq) & 1) << 2);
+    bdir = bounce[bdir][code];
+    if (bdir < 0) {
+      *hit = sq;
+      return path;
     }
-    
-    uint64_t hit = ray & pieces;
-    if (hit == 0) {
-      return 0;
+  }
+}
+
+// Traces the beam of every Monarch on the board into p->lasers.
+void update_lasers(position_t* p) {
+  for (color_t c = WHITE; c <= BLACK; c++) {
+    uint64_t monarchs = monarchs_of(p, c);
+    for (int n = 0; n < MAX_MONARCHS; n++) {
+      if (monarchs) {
+        p->lasers.path[c][n] = trace_laser(p, __builtin_ctzll(monarchs),
+                                           &p->lasers.hit[c][n]);
+        monarchs &= monarchs - 1;
+      } else {
+        p->lasers.path[c][n] = 0;
+        p->lasers.hit[c][n] = BOARD_SIZE;
+      }
     }
+  }
+}
 
-    if (bdir & 0b10) {
-      //Shooting south or west, get the most-significant bit
-      sq = sq_to_bit_index[63 - __builtin_clzl(hit)] ;
-    } else {
-      //Shooting north or east, get the least-significant bit
-      sq = sq_to_bit_index[__builtin_ctzl(hit)];
-    }
-    tbassert(sq < ARR_SIZE && sq >= 0, "sq: %d\n", sq);
-    piece_t piece = p->board[sq];
-    if (ptype_of(piece) == PAWN) {
-      bdir = reflect_of(bdir, ori_of(piece));
-      if (bdir < 0) {
-        return sq;
+// Brings p->lasers up to date after the pieces on the squares in changed were
+// placed, removed or rotated.  A beam whose path misses every changed square
+// is unaffected and is not traced again.  Slots follow square order, so if a
+// Monarch itself was among the changed pieces every beam is traced again.
+static inline void refresh_lasers(position_t* p, uint64_t changed,
+                                  uint64_t monarchs_before) {
+  if (changed & (monarchs_before | p->monarchs)) {
+    update_lasers(p);
+    return;
+  }
+  for (color_t c = WHITE; c <= BLACK; c++) {
+    uint64_t monarchs = monarchs_of(p, c);
+    for (int n = 0; monarchs; n++, monarchs &= monarchs - 1) {
+      if (p->lasers.path[c][n] & changed) {
+        p->lasers.path[c][n] = trace_laser(p, __builtin_ctzll(monarchs),
+                                           &p->lasers.hit[c][n]);
+      }
+    }
+  }
+}
+
+#ifndef NDEBUG
+// Whether p->lasers matches a fresh trace of every beam.
+static bool lasers_are_current(position_t* p) {
+  position_t fresh = *p;
+  update_lasers(&fresh);
+  for (color_t c = WHITE; c <= BLACK; c++) {
+    for (int n = 0; n < MAX_MONARCHS; n++) {
+      if (fresh.lasers.path[c][n] != p->lasers.path[c][n] ||
+          fresh.lasers.hit[c][n] != p->lasers.hit[c][n]) {
+        return false;
       }
-    } else {
-      return sq;
     }
   }
+  return true;
 }
+#endif
 
 // returns number of victims
-__attribute__((always_inline)) square_t fire_lasers(position_t* p, color_t c) {
-  square_t sq = get_monarch(p, c, 0);
+__attribute__((always_inline)) int fire_lasers(position_t* p, color_t c) {
   int victims = 0;
-  if (ptype_of(p->board[sq]) == MONARCH)
-    if (fire_laser(p, sq)) victims++;
-  sq = get_monarch(p, c, 1);
-  if (ptype_of(p->board[sq]) == MONARCH)
-    if (fire_laser(p, sq)) victims++;
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    if (p->lasers.hit[c][n] < BOARD_SIZE) victims++;
+  }
   return victims;
 }
 
-void low_level_make_move(position_t* old, position_t* p, move_t mv) {
+// Whether a piece pushed off to_sq lands on next_sq, i.e. next_sq is an empty
+// square adjacent to to_sq.  Squares past the edge of the board wrap to a
+// square >= BOARD_SIZE or to a square that is not adjacent to to_sq.
+static inline bool is_free_push_square(position_t* p, square_t to_sq,
+                                       square_t next_sq) {
+  uint64_t empty = ~(p->piece_loc[WHITE] | p->piece_loc[BLACK]);
+  return next_sq < BOARD_SIZE &&
+         ((neighbors_of(sq_to_bit(to_sq)) & empty) >> next_sq) & 1;
+}
+
+// Moves (or rotates) the piece on mv's from-square in place, recording the lifted
+// pieces in u.
+void low_level_make_move(position_t* p, move_t mv, undo_t* u) {
   tbassert(!move_eq(mv, NULL_MOVE), "mv was zero.\n");
 
   WHEN_DEBUG_VERBOSE(char buf[MAX_CHARS_IN_MOVE]);
@@ -492,20 +854,20 @@ void low_level_make_move(position_t* old, position_t* p, move_t mv) {
     DEBUG_LOG(1, "low_level_make_move: %s\n", buf);
   });
 
-  tbassert(old->key == compute_zob_key(old),
-           "old->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", old->key,
-           compute_zob_key(old));
+  tbassert(p->key == compute_zob_key(p),
+           "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
+           compute_zob_key(p));
 
   WHEN_DEBUG_VERBOSE({
     fprintf(stderr, "Before:\n");
-    display(old);
+    display(p);
   });
 
-  square_t from_sq = mv.from_sq;
-  square_t to_sq = mv.to_sq;
+  square_t from_sq = from_square(mv);
+  square_t to_sq = to_square(mv);
   int dir = to_sq - from_sq;
   square_t next_sq = from_sq + dir + dir;
-  rot_t rot = mv.rot;
+  rot_t rot = rot_of(mv);
 
   WHEN_DEBUG_VERBOSE({
     DEBUG_LOG(1, "low_level_make_move 2:\n");
@@ -534,80 +896,49 @@ void low_level_make_move(position_t* old, position_t* p, move_t mv) {
     }
   });
 
-  *p = *old;
-  p->history = old;
   p->last_move = mv;
 
-  tbassert(from_sq < ARR_SIZE && from_sq > 0, "from_sq: %d\n", from_sq);
-  tbassert((p->board[from_sq]) < (1 << PIECE_INDEX_SIZE) &&
-               (p->board[from_sq]) >= 0,
-           "p->board[from_sq]: %d\n", (p->board[from_sq]));
-  tbassert(to_sq < ARR_SIZE && to_sq > 0, "to_sq: %d\n", to_sq);
-  tbassert((p->board[to_sq]) < (1 << PIECE_INDEX_SIZE) &&
-               (p->board[to_sq]) >= 0,
-           "p->board[to_sq]: %d\n", (p->board[to_sq]));
+  tbassert(from_sq < BOARD_SIZE, "from_sq: %d\n", from_sq);
+  tbassert(to_sq < BOARD_SIZE, "to_sq: %d\n", to_sq);
 
   p->key ^= zob_color;  // swap color to move
+  p->sym_key ^= zob_color;
 
-  piece_t from_piece = p->board[from_sq];
-  piece_t to_piece = p->board[to_sq];
-  piece_t next_piece = p->board[next_sq];
+  piece_t from_piece = piece_at(p, from_sq);
+  u->moved = from_piece;
+  u->pushed = NULL_PIECE;
+  u->push_sq = BOARD_SIZE;
 
   if (to_sq != from_sq) {  // move, not rotation
-    // Hash key updates
-    p->key ^= zob[from_sq]
-                 [(from_piece)];  // remove from_piece from from_sq
-    p->key ^= zob[to_sq][(to_piece)];  // remove to_piece from to_sq
-
-    p->board[from_sq] = NULL_PIECE;
-    p->key ^= zob[from_sq][0];
-
-    color_t from_color = color_of(from_piece);
-    color_t to_color = color_of(to_piece);
-    
-    // UPDATE:piece_loc
-    // First, remove the from_piece and to_piece
-    p->piece_loc[from_color] &= (~sq_to_bitmask[from_sq]); //CLEAR
-    p->piece_loc[to_color]  &= (~sq_to_bitmask[to_sq]);
-
-    int monarch_ptr = 0;
-    if (ptype_of(from_piece) == MONARCH) {
-      if (p->monarch_loc[from_color][monarch_ptr] == from_sq) {
-        p->monarch_loc[from_color][monarch_ptr] = 0;
-      } else {
-        monarch_ptr = 1;
-        p->monarch_loc[from_color][monarch_ptr] = 0;
-      }
-      p->monarch_loc[from_color][monarch_ptr] = to_sq;
-    }
-
-    if (ptype_of(next_piece) == EMPTY) {
-      // empty
-      p->board[to_sq] = from_piece;
-      p->key ^= zob[to_sq][(from_piece)];
-      p->board[next_sq] = to_piece;
-      p->key ^= zob[next_sq][(next_piece)];
-      p->key ^= zob[next_sq][(to_piece)];
-      // CASE 1: next_sq is empty
-      p->piece_loc[from_color] |= sq_to_bitmask[to_sq]; //ADD
-      if (ptype_of(to_piece) == PAWN || ptype_of(to_piece) == MONARCH) {
-        p->piece_loc[to_color] |= sq_to_bitmask[next_sq]; //ADD
-      }
+    piece_t to_piece = piece_at(p, to_sq);
+    // A piece on to_sq is pushed on to next_sq if that square is on the board
+    // and empty; otherwise it is squashed.
+    u->pushed = to_piece;
+    if (to_piece != NULL_PIECE && is_free_push_square(p, to_sq, next_sq)) {
+      u->push_sq = next_sq;
+    }
 
-    } else {
-      // off board or occupied
-      p->board[to_sq] = from_piece;
-      p->key ^= zob[to_sq][(from_piece)];
-      //CASE 2: next_sq is off board or occupied
-      p->piece_loc[from_color] |= sq_to_bitmask[to_sq];
+    // Hash key updates
+    hash_piece(p, from_sq, from_piece);  // remove from_piece from from_sq
+    remove_piece(p, from_sq);
+    if (to_piece != NULL_PIECE) {
+      hash_piece(p, to_sq, to_piece);  // remove to_piece from to_sq
+      remove_piece(p, to_sq);
     }
+    place_piece(p, to_sq, from_piece);
+    hash_piece(p, to_sq, from_piece);
 
+    if (u->push_sq < BOARD_SIZE) {
+      place_piece(p, next_sq, to_piece);
+      hash_piece(p, next_sq, to_piece);
+    }
   } else {  // rotation
     // remove from_piece from from_sq in hash
-    p->key ^= zob[from_sq][from_piece];
+    hash_piece(p, from_sq, from_piece);
     set_ori(&from_piece, (uint8_t)((rot + ori_of(from_piece)) % NUM_ORI));
-    p->board[from_sq] = from_piece;  // place rotated piece on board
-    p->key ^= zob[from_sq][from_piece];  // ... and in hash
+    remove_piece(p, from_sq);
+    place_piece(p, from_sq, from_piece);  // place rotated piece on board
+    hash_piece(p, from_sq, from_piece);  // ... and in hash
   }
 
   // Increment ply
@@ -616,6 +947,9 @@ void low_level_make_move(position_t* old, position_t* p, move_t mv) {
   tbassert(p->key == compute_zob_key(p),
            "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
            compute_zob_key(p));
+  tbassert(p->sym_key == compute_sym_key(p),
+           "p->sym_key: %" PRIu64 ", sym-key: %" PRIu64 "\n", p->sym_key,
+           compute_sym_key(p));
 
   WHEN_DEBUG_VERBOSE({
     fprintf(stderr, "After:\n");
@@ -660,137 +994,451 @@ bool do_pawns_touch(pawn_ori_t ori_p1, pawn_ori_t ori_p2, compass_t dir) {
 // Victims update
 // -----------------------------------------------------------------------------
 
-// returns victim pieces (does not mark position as actually played)
-victims_t make_move(position_t* old, position_t* p, move_t mv) {
+// Makes mv on p in place and returns victim pieces (does not mark position as
+// actually played).  u receives everything unmake_move() needs to take the
+// move back; it must stay alive for as long as the move is on the board,
+// since p->cold.history points at it.
+victims_t make_move(position_t* p, move_t mv, undo_t* u) {
   tbassert(!move_eq(mv, NULL_MOVE), "mv was zero.\n");
 
   WHEN_DEBUG_VERBOSE(char buf[MAX_CHARS_IN_MOVE]);
 
-  // move phase 1 - moving a piece
-  low_level_make_move(old, p, mv);
-  p->victims.count = 0;
-  p->victims.removed_color[WHITE] = false;
-  p->victims.removed_color[BLACK] = false;
-  square_t victim_sq1 = 0;
-  square_t victim_sq2 = 0;
-  color_t previous_color = color_to_move_of(old);
-  square_t monarch_0 = get_monarch(p, previous_color, 0);
-  square_t monarch_1 = get_monarch(p, previous_color, 1);
-  victim_sq1 = fire_laser(p, monarch_0);
-  victim_sq2 = fire_laser(p, monarch_1);
-
-  if (victim_sq1) {
-    WHEN_DEBUG_VERBOSE({
-      square_to_str(victim_sq, buf, MAX_CHARS_IN_MOVE);
-      DEBUG_LOG(3, "Zapping piece on %s\n", buf);
-    });
-    // We definitely hit something with the laser.  Remove it from the board.
-      piece_t piece = p->board[victim_sq1];
-      WHEN_DEBUG_VERBOSE({
-        fprintf(stdout, "Before:\n");
-        display(p);
-      });
-      // remove victim
-      tbassert(victim_sq1 > 0 && victim_sq1 < ARR_WIDTH * ARR_WIDTH, "Bad square! %d\n", victim_sq1);
-      p->key ^= zob[victim_sq1][piece];
-      p->board[victim_sq1] = NULL_PIECE;
-      p->key ^= zob[victim_sq1][0];
-      color_t c = color_of(piece);
-      p->piece_loc[c] &= (~sq_to_bitmask[victim_sq1]); //CLEAR
-      
-      if (ptype_of(piece) == MONARCH) {
-        if (p->monarch_loc[c][0] == victim_sq1) {
-          p->monarch_loc[c][0] = 0;
-        } else {
-          p-> monarch_loc[c][1] = 0;
-        }
-      }
+  // Save the scalar state that this move overwrites
+  u->key = p->key;
+  u->sym_key = p->sym_key;
+  u->pawn_key = p->pawn_key;
+  u->history = p->cold.history;
+  u->nply_since_victim = p->nply_since_victim;
+  u->last_move = p->last_move;
+  u->victims = p->cold.victims;
+  u->was_played = p->cold.was_played;
+  u->lasers = p->lasers;
+  u->acc = p->acc;
+  u->num_zapped = 0;
+
+  color_t previous_color = color_to_move_of(p);
+  uint64_t monarchs_before = p->monarchs;
 
-      tbassert(p->key == compute_zob_key(p),
-              "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
-              compute_zob_key(p));
-      WHEN_DEBUG_VERBOSE({
-        fprintf(stdout, "After:\n");
-        display(p);
-      });
-    p->victims.count++;
-    p->victims.removed_color[c] = true;
+  // move phase 1 - moving a piece
+  low_level_make_move(p, mv, u);
+  p->cold.history = u;
+  p->cold.victims.count = 0;
+  p->cold.victims.removed_color[WHITE] = false;
+  p->cold.victims.removed_color[BLACK] = false;
+
+  // Only beams crossing a square whose piece changed need tracing again
+  square_t from_sq = from_square(mv);
+  square_t to_sq = to_square(mv);
+  uint64_t changed = 0;
+  if (from_sq != to_sq || rot_of(mv) != NONE) {  // not a null move
+    changed = sq_to_bit(from_sq) | sq_to_bit(to_sq);
+    if (u->push_sq < BOARD_SIZE) {
+      changed |= sq_to_bit(u->push_sq);
+    }
   }
+  refresh_lasers(p, changed, monarchs_before);
+
+  // move phase 2 - every laser of the mover fires on the new board, and only
+  // then are the victims removed
+  uint64_t victim_bits[MAX_MONARCHS] = {0, 0};
+  piece_t victim_pieces[MAX_MONARCHS] = {NULL_PIECE, NULL_PIECE};
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    square_t hit = p->lasers.hit[previous_color][n];
+    if (hit < BOARD_SIZE) {
+      victim_bits[n] = sq_to_bit(hit);
+      victim_pieces[n] = piece_at(p, hit);
+    }
+  }
+
+  monarchs_before = p->monarchs;
+  uint64_t zapped = 0;
 
-  if (victim_sq2) {
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    if (!victim_bits[n]) {
+      continue;
+    }
+    // We definitely hit something with the laser.  Remove it from the board
+    // (unless the other laser already did).
+    square_t victim_sq = __builtin_ctzll(victim_bits[n]);
     WHEN_DEBUG_VERBOSE({
       square_to_str(victim_sq, buf, MAX_CHARS_IN_MOVE);
       DEBUG_LOG(3, "Zapping piece on %s\n", buf);
-    });
-    piece_t piece = p->board[victim_sq2];
-    WHEN_DEBUG_VERBOSE({
       fprintf(stdout, "Before:\n");
       display(p);
     });
-    tbassert(victim_sq2 > 0 && victim_sq2 < ARR_WIDTH * ARR_WIDTH, "Bad square! %d\n", victim_sq2);
-    p->key ^= zob[victim_sq2][piece];
-    p->board[victim_sq2] = NULL_PIECE;
-    p->key ^= zob[victim_sq2][0];
-    color_t c = color_of(piece);
-    p->piece_loc[c] &= (~sq_to_bitmask[victim_sq2]); //CLEAR
-    
-    if (ptype_of(piece) == MONARCH) {
-      if (p->monarch_loc[c][0] == victim_sq2) {
-        p->monarch_loc[c][0] = 0;
-      } else {
-        p-> monarch_loc[c][1] = 0;
-      }
+    if ((p->piece_loc[WHITE] | p->piece_loc[BLACK]) & victim_bits[n]) {
+      u->zapped[u->num_zapped] = victim_pieces[n];
+      u->zapped_sq[u->num_zapped] = victim_sq;
+      u->num_zapped++;
+      hash_piece(p, victim_sq, victim_pieces[n]);
+      remove_piece(p, victim_sq);
+      zapped |= victim_bits[n];
     }
 
     tbassert(p->key == compute_zob_key(p),
-            "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
-            compute_zob_key(p));
+             "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
+             compute_zob_key(p));
     WHEN_DEBUG_VERBOSE({
       fprintf(stdout, "After:\n");
       display(p);
     });
-    // We definitely hit something with the laser.  Remove it from the board.
-    p->victims.count++;
-    p->victims.removed_color[c] = true;
+    p->cold.victims.count++;
+    p->cold.victims.removed_color[color_of(victim_pieces[n])] = true;
   }
 
-  piece_t to_piece = old->board[mv.to_sq];
-  if (ptype_of(to_piece) == PAWN) {
-    // Check if we squashed the piece at mv.to_sq: is the cell it's pushed to empty?
-    int dir = mv.to_sq - mv.from_sq;
-    square_t pushed_next_sq = mv.to_sq + dir;
-    if (mv.to_sq != mv.from_sq && ptype_of(old->board[pushed_next_sq]) != EMPTY) {
-      p->victims.count++;
-      p->victims.removed_color[color_of(to_piece)] = true;
-    }
+  if (zapped) {
+    refresh_lasers(p, zapped, monarchs_before);
+  }
+  tbassert(lasers_are_current(p), "Laser cache is stale after make_move\n");
+  tbassert(p->pawn_key == compute_pawn_key(p),
+           "p->pawn_key: %" PRIu64 ", pawn-key: %" PRIu64 "\n", p->pawn_key,
+           compute_pawn_key(p));
+  eval_acc_update(p, u);
+  if (USE_NNUE) {
+    nnue_update(p, u);
+  }
+
+  // A Pawn that was pushed off the to-square with nowhere to go got squashed
+  if (ptype_of(u->pushed) == PAWN && u->push_sq == BOARD_SIZE) {
+    p->cold.victims.count++;
+    p->cold.victims.removed_color[color_of(u->pushed)] = true;
   }
 
-  if (p->victims.count == 0) {
+  if (p->cold.victims.count == 0) {
     // increment ply counter since last victim
-    p->nply_since_victim = old->nply_since_victim + 1;
+    p->nply_since_victim = u->nply_since_victim + 1;
   } else {
     // reset ply counter since last victim
     p->nply_since_victim = 0;
   }
   // mark position as not played (yet)
-  p->was_played = false;
-  return p->victims;
+  p->cold.was_played = false;
+
+  tbassert(p->rep_top + 1 < REP_HISTORY_SIZE, "Repetition history is full\n");
+  p->rep_top++;
+  p->reps->keys[p->rep_top] = p->key;
+  p->reps->filter[p->key & REP_FILTER_MASK]++;
+  return p->cold.victims;
 }
 
-victims_t actually_make_move(position_t* old, position_t* p, move_t mv) {
-  make_move(old, p, mv);
-  p->was_played = true;
-  return p->victims;
+// Fills in everything but the effect of a prediction.  A move whose squares
+// miss every beam of the mover hits what the cached beams hit now; otherwise
+// only the bitboards of the position are updated, on a scratch copy, and the
+// mover's beams are traced on it.
+static inline void predict_board(position_t* p, move_t mv,
+                                 movePrediction_t* out) {
+  color_t c = color_to_move_of(p);
+  square_t from_sq = from_square(mv);
+  square_t to_sq = to_square(mv);
+  square_t next_sq = to_sq + to_sq - from_sq;
+
+  out->moved = piece_at(p, from_sq);
+  out->pushed = NULL_PIECE;
+  out->push_sq = BOARD_SIZE;
+  uint64_t changed = 0;
+  if (from_sq != to_sq) {
+    changed = sq_to_bit(from_sq) | sq_to_bit(to_sq);
+    out->pushed = piece_at(p, to_sq);
+    if (out->pushed != NULL_PIECE && is_free_push_square(p, to_sq, next_sq)) {
+      out->push_sq = next_sq;
+      changed |= sq_to_bit(next_sq);
+    }
+  } else if (rot_of(mv) != NONE) {
+    changed = sq_to_bit(from_sq);
+  }
+
+  if (!(changed & (p->lasers.path[c][0] | p->lasers.path[c][1]))) {
+    // No beam of the mover changes, so neither does what it hits
+    for (int n = 0; n < MAX_MONARCHS; n++) {
+      out->hits[n] = p->lasers.hit[c][n];
+      out->hit_pieces[n] =
+          out->hits[n] < BOARD_SIZE ? piece_at(p, out->hits[n]) : NULL_PIECE;
+    }
+    return;
+  }
+
+  position_t q;  // only the bitboards are filled in
+  q.piece_loc[WHITE] = p->piece_loc[WHITE];
+  q.piece_loc[BLACK] = p->piece_loc[BLACK];
+  q.monarchs = p->monarchs;
+  q.ori_bits[0] = p->ori_bits[0];
+  q.ori_bits[1] = p->ori_bits[1];
+
+  piece_t moved = out->moved;
+  remove_piece(&q, from_sq);
+  if (from_sq != to_sq) {
+    if (out->pushed != NULL_PIECE) {
+      remove_piece(&q, to_sq);
+      if (out->push_sq < BOARD_SIZE) {
+        place_piece(&q, out->push_sq, out->pushed);
+      }
+    }
+  } else {
+    set_ori(&moved, (uint8_t)((rot_of(mv) + ori_of(moved)) % NUM_ORI));
+  }
+  place_piece(&q, to_sq, moved);
+
+  uint64_t monarchs = monarchs_of(&q, c);
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    out->hits[n] = BOARD_SIZE;
+    out->hit_pieces[n] = NULL_PIECE;
+    if (monarchs) {
+      trace_laser(&q, __builtin_ctzll(monarchs), &out->hits[n]);
+      if (out->hits[n] < BOARD_SIZE) {
+        out->hit_pieces[n] = piece_at(&q, out->hits[n]);
+      }
+      monarchs &= monarchs - 1;
+    }
+  }
+}
+
+// Classifies a move by the pieces pred says it removes
+static moveEffect_t effect_of(position_t* p, const movePrediction_t* pred) {
+  color_t c = color_to_move_of(p);
+
+  int removed[2] = {0, 0};        // pieces removed, by color
+  int monarchs_lost[2] = {0, 0};  // ... of which Monarchs
+  int count = 0;
+  if (ptype_of(pred->pushed) == PAWN && pred->push_sq == BOARD_SIZE) {
+    removed[color_of(pred->pushed)]++;  // squashed
+    count++;
+  }
+
+  // Every beam that hits something counts as a victim, as in make_move()
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    if (pred->hits[n] == BOARD_SIZE) {
+      continue;
+    }
+    count++;
+    piece_t victim = pred->hit_pieces[n];
+    removed[color_of(victim)]++;
+    if (ptype_of(victim) == MONARCH &&
+        !(n == 1 && pred->hits[0] == pred->hits[1])) {  // don't count it twice
+      monarchs_lost[color_of(victim)]++;
+    }
+  }
+
+  // Moves neither create nor squash Monarchs
+  int white_monarchs =
+      __builtin_popcountll(monarchs_of(p, WHITE)) - monarchs_lost[WHITE];
+  int black_monarchs =
+      __builtin_popcountll(monarchs_of(p, BLACK)) - monarchs_lost[BLACK];
+  if (is_game_over_with(white_monarchs, black_monarchs, opp_color(c))) {
+    return EFFECT_GAME_OVER;
+  }
+  if (count == 0) {
+    return EFFECT_QUIET;
+  }
+  if (!removed[opp_color(c)]) {
+    return EFFECT_ZAP_OWN;
+  }
+  if (pred->hits[0] == BOARD_SIZE && pred->hits[1] == BOARD_SIZE) {
+    return EFFECT_SQUASH;
+  }
+  return EFFECT_ZAP_ENEMY;
+}
+
+// Predicts what mv does without making it.  pred->effect agrees with
+// make_move() on the victims and with is_game_over() on the resulting
+// position.
+void predict_move(position_t* p, move_t mv, movePrediction_t* pred) {
+  predict_board(p, mv, pred);
+  pred->effect = effect_of(p, pred);
+}
+
+// Adds or removes piece x on sq in the keys *key and *sym_key.
+static inline void hash_piece_in(uint64_t* key, uint64_t* sym_key, square_t sq,
+                                 piece_t x) {
+  *key ^= zob[sq][x];
+  *sym_key ^= zob_sym[sq][x];
+}
+
+// The key of the position mv leads to, laser victims included, computed from
+// the zob table and mv's prediction without making the move -- early enough to
+// prefetch that position's transposition table entry while the move is being
+// made.  Its sym_key goes to *sym_key.
+uint64_t key_after(position_t* p, move_t mv, const movePrediction_t* pred,
+                   uint64_t* sym_key) {
+  square_t from_sq = from_square(mv);
+  square_t to_sq = to_square(mv);
+  uint64_t key = p->key ^ zob_color;
+  *sym_key = p->sym_key ^ zob_color;
+  if (from_sq != to_sq) {
+    hash_piece_in(&key, sym_key, from_sq, pred->moved);
+    hash_piece_in(&key, sym_key, to_sq, pred->moved);
+    if (pred->pushed != NULL_PIECE) {
+      hash_piece_in(&key, sym_key, to_sq, pred->pushed);
+      if (pred->push_sq < BOARD_SIZE) {
+        hash_piece_in(&key, sym_key, pred->push_sq, pred->pushed);
+      }
+    }
+  } else if (rot_of(mv) != NONE) {
+    piece_t rotated = pred->moved;
+    set_ori(&rotated, (uint8_t)((rot_of(mv) + ori_of(rotated)) % NUM_ORI));
+    hash_piece_in(&key, sym_key, from_sq, pred->moved);
+    hash_piece_in(&key, sym_key, from_sq, rotated);
+  }
+
+  for (int n = 0; n < MAX_MONARCHS; n++) {
+    if (pred->hits[n] < BOARD_SIZE &&
+        !(n == 1 && pred->hits[0] == pred->hits[1])) {  // removed only once
+      hash_piece_in(&key, sym_key, pred->hits[n], pred->hit_pieces[n]);
+    }
+  }
+  return key;
+}
+
+// Takes back the move recorded in u, which must be the last move made on p.
+void unmake_move(position_t* p, undo_t* u) {
+  tbassert(p->cold.history == u, "unmake_move: u is not the last move made\n");
+  if (USE_NNUE) {
+    nnue_revert(p, u);
+  }
+  square_t from_sq = from_square(p->last_move);
+  square_t to_sq = to_square(p->last_move);
+
+  // Put the laser victims back, in reverse order of removal
+  for (int n = u->num_zapped - 1; n >= 0; n--) {
+    place_piece(p, u->zapped_sq[n], u->zapped[n]);
+  }
+
+  if (from_sq != to_sq) {
+    remove_piece(p, to_sq);
+    if (u->push_sq < BOARD_SIZE) {
+      remove_piece(p, u->push_sq);
+    }
+    if (u->pushed != NULL_PIECE) {
+      place_piece(p, to_sq, u->pushed);
+    }
+  } else {
+    remove_piece(p, from_sq);
+  }
+  place_piece(p, from_sq, u->moved);
+
+  p->reps->filter[p->key & REP_FILTER_MASK]--;
+  p->rep_top--;
+
+  p->ply--;
+  p->key = u->key;
+  p->sym_key = u->sym_key;
+  p->pawn_key = u->pawn_key;
+  p->cold.history = u->history;
+  p->nply_since_victim = u->nply_since_victim;
+  p->last_move = u->last_move;
+  p->cold.victims = u->victims;
+  p->cold.was_played = u->was_played;
+  p->lasers = u->lasers;
+  p->acc = u->acc;
+
+  tbassert(lasers_are_current(p), "Laser cache is stale after unmake_move\n");
+  tbassert(p->key == compute_zob_key(p),
+           "p->key: %" PRIu64 ", zob-key: %" PRIu64 "\n", p->key,
+           compute_zob_key(p));
+  tbassert(p->sym_key == compute_sym_key(p),
+           "p->sym_key: %" PRIu64 ", sym-key: %" PRIu64 "\n", p->sym_key,
+           compute_sym_key(p));
+  tbassert(p->pawn_key == compute_pawn_key(p),
+           "p->pawn_key: %" PRIu64 ", pawn-key: %" PRIu64 "\n", p->pawn_key,
+           compute_pawn_key(p));
+}
+
+victims_t actually_make_move(position_t* p, move_t mv, undo_t* u) {
+  make_move(p, mv, u);
+  p->cold.was_played = true;
+  p->reps->played = p->rep_top;
+  return p->cold.victims;
+}
+
+// -----------------------------------------------------------------------------
+// Repetition history
+// -----------------------------------------------------------------------------
+
+// Starts r off with p as the first position of a game.
+void rep_history_init(position_t* p, repHistory_t* r) {
+  memset(r->filter, 0, sizeof(r->filter));
+  r->keys[0] = p->key;
+  r->filter[p->key & REP_FILTER_MASK] = 1;
+  r->played = 0;
+  r->from_start = true;
+  p->reps = r;
+  p->rep_top = 0;
+}
+
+// Moves p over to the history r, keeping the keys of the positions since the
+// last victim.  Copies of a position that are searched in parallel each need a
+// history of their own to push onto.
+void rep_history_fork(position_t* p, repHistory_t* r) {
+  const repHistory_t* src = p->reps;
+  int base = p->rep_top - p->nply_since_victim;
+  tbassert(base >= 0, "Repetition history is missing keys\n");
+
+  memset(r->filter, 0, sizeof(r->filter));
+  for (int i = 0; i <= p->nply_since_victim; i++) {
+    uint64_t key = src->keys[base + i];
+    r->keys[i] = key;
+    r->filter[key & REP_FILTER_MASK]++;
+  }
+  r->played = (src->played < p->rep_top ? src->played : p->rep_top) - base;
+  r->from_start = src->from_start && base == 0;
+  p->reps = r;
+  p->rep_top = p->nply_since_victim;
 }
 
 // -----------------------------------------------------------------------------
 // Move path enumeration (perft)
 // -----------------------------------------------------------------------------
 
+int PERFT_HASH;  // perft hash table size in MBytes; 0 disables it
+
+// Perft transposition table: leaf counts keyed on Zobrist key and depth.
+// Workers read and write entries without locking, so each entry stores its key
+// XORed with its data; a torn entry fails the check and reads as a miss.
+//
+// https://www.chessprogramming.org/Perft#Speed_up
+// https://www.chessprogramming.org/Shared_Hash_Table#Lockless
+typedef struct {
+  uint64_t check;  // key ^ data
+  uint64_t data;   // leaf count << 8 | depth
+} perftRec_t;
+
+static perftRec_t* perft_table = NULL;
+static uint64_t perft_mask = 0;
+static int perft_table_size = 0;  // in MBytes
+
+// Allocates (or resizes) and clears the perft table for a new perft run.
+static void perft_make_hashtable() {
+  if (perft_table_size != PERFT_HASH) {
+    free(perft_table);
+    perft_table = NULL;
+    perft_mask = 0;
+    perft_table_size = PERFT_HASH;
+    if (PERFT_HASH > 0) {
+      uint64_t num_of_recs = 1;
+      while (2 * num_of_recs * sizeof(perftRec_t) <=
+             (uint64_t)PERFT_HASH << 20) {
+        num_of_recs *= 2;
+      }
+      perft_table = (perftRec_t*)malloc(num_of_recs * sizeof(perftRec_t));
+      if (perft_table == NULL) {
+        fprintf(stderr, "Perft hash table too big\n");
+        exit(1);
+      }
+      perft_mask = num_of_recs - 1;
+    }
+  }
+  if (perft_table) {
+    memset(perft_table, 0, (perft_mask + 1) * sizeof(perftRec_t));
+  }
+}
+
+static inline perftRec_t* perft_rec_of(uint64_t key, int depth) {
+  return &perft_table[(key ^ (depth * 0x9E3779B97F4A7C15ULL)) & perft_mask];
+}
+
 // Helper function for do_perft() (for root call, use ply 0).
 static uint64_t perft_search(position_t* p, int depth, int ply) {
   uint64_t node_count = 0;
-  position_t np;
+  undo_t undo;
   sortable_move_t lst[MAX_NUM_MOVES];
   int num_moves;
   int i;
@@ -799,6 +1447,15 @@ static uint64_t perft_search(position_t* p, int depth, int ply) {
     return 1;
   }
 
+  perftRec_t* rec = NULL;
+  if (perft_table && depth > 1) {
+    rec = perft_rec_of(p->key, depth);
+    uint64_t data = rec->data;
+    if ((rec->check ^ data) == p->key && (data & 0xFF) == (uint64_t)depth) {
+      return data >> 8;
+    }
+  }
+
   num_moves = generate_all(p, lst);
 
   if (depth == 1) {
@@ -807,75 +1464,224 @@ static uint64_t perft_search(position_t* p, int depth, int ply) {
 
   for (i = 0; i < num_moves; i++) {
     move_t mv = get_move(lst[i]);
-    make_move(p, &np, mv);
+    make_move(p, mv, &undo);
 
-    if (is_game_over(&np)) {
+    if (is_game_over(p)) {
       // do not expand further: hit a Monarch
       node_count++;
-      continue;
+    } else {
+      node_count += perft_search(p, depth - 1, ply + 1);
     }
+    unmake_move(p, &undo);
+  }
+
+  if (rec) {
+    uint64_t data = node_count << 8 | depth;
+    rec->data = data;
+    rec->check = p->key ^ data;
+  }
+  return node_count;
+}
 
-    uint64_t partialcount = perft_search(&np, depth - 1, ply + 1);
-    node_count += partialcount;
+// Leaf count below one root move; each root move searches its own copy of
+// the position so that they can run in parallel.
+static uint64_t perft_root_move(position_t* p, move_t mv, int depth) {
+  position_t child = *p;
+  repHistory_t reps;
+  rep_history_fork(&child, &reps);
+  undo_t undo;
+  make_move(&child, mv, &undo);
+  if (is_game_over(&child)) {
+    return 1;
   }
+  return perft_search(&child, depth - 1, 1);
+}
 
+// Counts the leaves depth plies below p into counts[i] for each root move
+// lst[i], spawning over the root moves in PARALLEL builds.  Returns the total.
+static uint64_t perft_root(position_t* p, int depth, sortable_move_t* lst,
+                           int num_moves, uint64_t* counts) {
+  if (depth == 0) {
+    return 1;
+  }
+  #ifdef PARALLEL
+    cilk_for (int i = 0; i < num_moves; i++) {
+      counts[i] = perft_root_move(p, get_move(lst[i]), depth);
+    }
+  #else
+    for (int i = 0; i < num_moves; i++) {
+      counts[i] = perft_root_move(p, get_move(lst[i]), depth);
+    }
+  #endif
+  uint64_t node_count = 0;
+  for (int i = 0; i < num_moves; i++) {
+    node_count += counts[i];
+  }
   return node_count;
 }
 
+static int perft_workers() {
+  #ifdef PARALLEL
+    return __cilkrts_get_nworkers();
+  #else
+    return 1;
+  #endif
+}
+
+static void print_perft_speed(uint64_t nodes, double elapsed) {
+  if (elapsed < 0.001) {
+    elapsed = 0.001;  // don't divide by 0
+  }
+  printf("info perft nodes %" PRIu64 " time (ms) %.1f nps %.0f workers %d"
+         " perft_hash %d\n",
+         nodes, elapsed, 1000.0 * nodes / elapsed, perft_workers(),
+         PERFT_HASH);
+}
+
 // Debugging function to perform a sanity check that the move generator is
-// working correctly.  Not a thorough test, but quick.
+// working correctly.  Not a thorough test, but quick.  Also serves as a move
+// generator benchmark: reports nodes per second and the number of workers.
 //
 // https://www.chessprogramming.org/Perft
 void do_perft(position_t* gme, int depth) {
+  sortable_move_t lst[MAX_NUM_MOVES];
+  uint64_t counts[MAX_NUM_MOVES];
+  int num_moves = generate_all(gme, lst);
+
+  perft_make_hashtable();
+  uint64_t nodes = 0;
+  double start = milliseconds();
   for (int d = 0; d <= depth; d++) {
     printf("info perft %2d ", d);
-    uint64_t j = perft_search(gme, d, 0);
+    uint64_t j = perft_root(gme, d, lst, num_moves, counts);
     printf("%" PRIu64 "\n", j);
+    nodes += j;
+  }
+  print_perft_speed(nodes, milliseconds() - start);
+}
+
+// Like do_perft(), but only at the given depth, listing the leaf count below
+// each root move.
+void do_perft_divide(position_t* gme, int depth) {
+  sortable_move_t lst[MAX_NUM_MOVES];
+  uint64_t counts[MAX_NUM_MOVES];
+  char buf[MAX_CHARS_IN_MOVE];
+  int num_moves = generate_all(gme, lst);
+
+  if (depth < 1) {
+    depth = 1;
+  }
+  perft_make_hashtable();
+  double start = milliseconds();
+  uint64_t nodes = perft_root(gme, depth, lst, num_moves, counts);
+  double elapsed = milliseconds() - start;
+  for (int i = 0; i < num_moves; i++) {
+    move_to_str(get_move(lst[i]), buf, MAX_CHARS_IN_MOVE);
+    printf("info divide %s %" PRIu64 "\n", buf, counts[i]);
+  }
+  printf("info perft %2d %" PRIu64 "\n", depth, nodes);
+  print_perft_speed(nodes, elapsed);
+}
+
+// Microbenchmark for update_lasers(), which make_move() falls back on when a
+// Monarch moves: traces every laser of the positions up to two moves away
+// from p, `iterations` times over, and reports beams per second.  With
+// beams_only, each Monarch's beam is traced on its own by trace_laser(),
+// without updating p->lasers or counting victims with fire_lasers().
+#define LASER_BENCH_POSITIONS 4096
+
+static int collect_positions(position_t* p, int depth, position_t* out, int n) {
+  sortable_move_t lst[MAX_NUM_MOVES];
+  undo_t undo;
+
+  int num_moves = generate_all(p, lst);
+  for (int i = 0; i < num_moves && n < LASER_BENCH_POSITIONS; i++) {
+    make_move(p, get_move(lst[i]), &undo);
+    out[n++] = *p;
+    if (depth > 1 && !is_game_over(p)) {
+      n = collect_positions(p, depth - 1, out, n);
+    }
+    unmake_move(p, &undo);
+  }
+  return n;
+}
+
+void do_laser_bench(position_t* p, int iterations, bool beams_only) {
+  static position_t positions[LASER_BENCH_POSITIONS];
+  int num_positions = collect_positions(p, 2, positions, 0);
+
+  uint64_t beams = 0;
+  uint64_t zaps = 0;
+  double start = milliseconds();
+  for (int it = 0; it < iterations; it++) {
+    for (int i = 0; i < num_positions; i++) {
+      if (beams_only) {
+        for (uint64_t m = positions[i].monarchs; m; m &= m - 1) {
+          square_t hit;
+          trace_laser(&positions[i], __builtin_ctzll(m), &hit);
+          zaps += hit < BOARD_SIZE;
+          beams++;
+        }
+        continue;
+      }
+      update_lasers(&positions[i]);
+      beams += __builtin_popcountll(positions[i].monarchs);
+      zaps += fire_lasers(&positions[i], WHITE) + fire_lasers(&positions[i], BLACK);
+    }
   }
+  double elapsed = milliseconds() - start;
+  if (elapsed < 0.001) {
+    elapsed = 0.001;  // don't divide by 0
+  }
+  printf("info laserbench positions %d beams %" PRIu64 " zaps %" PRIu64
+         " time (ms) %.1f beams/sec %.0f\n",
+         num_positions, beams, zaps, elapsed, 1000.0 * beams / elapsed);
 }
 
 // -----------------------------------------------------------------------------
 // Position display
 // -----------------------------------------------------------------------------
 
-void display(position_t* p) {
+static void display_monarchs(position_t* p) {
   char buf[MAX_CHARS_IN_MOVE];
 
+  for (color_t c = WHITE; c <= BLACK; c++) {
+    uint64_t monarchs = monarchs_of(p, c);
+    while (monarchs) {
+      square_to_str(__builtin_ctzll(monarchs), buf, MAX_CHARS_IN_MOVE);
+      printf("info %s Monarch: %s\n", color_to_str(c), buf);
+      monarchs &= monarchs - 1;
+    }
+  }
+}
+
+void display(position_t* p) {
   printf("info Ply: %d\n", p->ply);
   printf("info Color to move: %s\n", color_to_str(color_to_move_of(p)));
 
-  square_to_str(get_monarch(p, WHITE, 0), buf, MAX_CHARS_IN_MOVE);
-  printf("info White Monarch: %s\n", buf);
-  square_to_str(get_monarch(p, WHITE, 1), buf, MAX_CHARS_IN_MOVE);
-  printf("info White Monarch: %s\n", buf);
-  square_to_str(get_monarch(p, BLACK, 0), buf, MAX_CHARS_IN_MOVE);
-  printf("info Black Monarch: %s\n", buf);
-  square_to_str(get_monarch(p, BLACK, 1), buf, MAX_CHARS_IN_MOVE);
-  printf("info Black Monarch: %s\n", buf);
+  display_monarchs(p);
   printf("info");
   for (rnk_t r = BOARD_WIDTH - 1; r >= 0; --r) {
     printf("\ninfo %1d ", r);
     for (fil_t f = 0; f < BOARD_WIDTH; ++f) {
       square_t sq = square_of(f, r);
-      ptype_t sq_type = ptype_of(p->board[sq]);
-      if (sq_type == INVALID) printf("%d \n", sq);
-      tbassert(sq_type != INVALID, "p->board[sq].typ: %d\n",
-               sq_type);
+      piece_t piece = piece_at(p, sq);
+      ptype_t sq_type = ptype_of(piece);
       if (sq_type == EMPTY) {  // empty square
         printf(" --");
         continue;
       }
 
-      color_t c = color_of(p->board[sq]);
+      color_t c = color_of(piece);
 
       if (sq_type == MONARCH) {
-        int ori = (int) ori_of(p->board[sq]);
+        int ori = (int) ori_of(piece);
         printf(" %2s", monarch_ori_to_rep[c][ori]);
         continue;
       }
 
       if (sq_type == PAWN) {
-        int ori = (int) ori_of(p->board[sq]);
+        int ori = (int) ori_of(piece);
         printf(" %2s", pawn_ori_to_rep[c][ori]);
         continue;
       }
@@ -893,29 +1699,20 @@ void display(position_t* p) {
 }
 
 void bitboardDisplay(position_t* p) {
-  char buf[MAX_CHARS_IN_MOVE];
-
     printf("info Ply: %d\n", p->ply);
     printf("info Color to move: %s\n", color_to_str(color_to_move_of(p)));
 
-    square_to_str(get_monarch(p, WHITE, 0), buf, MAX_CHARS_IN_MOVE);
-    printf("info White Monarch: %s\n", buf);
-    square_to_str(get_monarch(p, WHITE, 1), buf, MAX_CHARS_IN_MOVE);
-    printf("info White Monarch: %s\n", buf);
-    square_to_str(get_monarch(p, BLACK, 0), buf, MAX_CHARS_IN_MOVE);
-    printf("info Black Monarch: %s\n", buf);
-    square_to_str(get_monarch(p, BLACK, 1), buf, MAX_CHARS_IN_MOVE);
-    printf("info Black Monarch: %s\n", buf);
+    display_monarchs(p);
     printf("info");
     for (rnk_t r = BOARD_WIDTH - 1; r >= 0; --r) {
       printf("\ninfo %1d ", r);
       for (fil_t f = 0; f < BOARD_WIDTH; ++f) {
         square_t sq = square_of(f, r);
-        if (p->piece_loc[WHITE] & (sq_to_bitmask[sq])) {
+        if (p->piece_loc[WHITE] & (sq_to_bit(sq))) {
           printf("  0");
         }
 
-        else if (p->piece_loc[BLACK] & (sq_to_bitmask[sq])) {
+        else if (p->piece_loc[BLACK] & (sq_to_bit(sq))) {
           printf("  1");
         }
 
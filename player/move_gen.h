@@ -11,6 +11,7 @@
 #define MAX_NUM_MOVES 256      // real number = 8 * (11) + 1 = 89
 #define MAX_PLY_IN_SEARCH 100  // up to 100 ply
 #define MAX_PLY_IN_GAME 4096   // long game!  ;^)
+#define CACHE_LINE_SIZE 64
 
 // Used for debugging and display
 #define MAX_CHARS_IN_MOVE 16  // Could be less
@@ -20,10 +21,6 @@
 // Board
 // -----------------------------------------------------------------------------
 
-// The board is centered in a ARR_WIDTH x ARR_WIDTH array, with the
-// (ample) excess height and width being used for sentinels.
-#define ARR_WIDTH 10
-#define ARR_SIZE (ARR_WIDTH * ARR_WIDTH)
 #define MAX_NUM_PAWNS_PER_COLOR 6
 
 // Board is BOARD_WIDTH x BOARD_WIDTH
@@ -34,36 +31,21 @@ typedef uint8_t square_t;
 typedef int8_t rnk_t;
 typedef int8_t fil_t;
 
-#define FIL_ORIGIN ((ARR_WIDTH - BOARD_WIDTH) / 2)
-#define RNK_ORIGIN ((ARR_WIDTH - BOARD_WIDTH) / 2)
-
-#define FIL_SHIFT 4
-#define FIL_MASK 0xF
+// A square is the bit index of its (file, rank) in a 64-bit bitboard:
+// sq = fil * BOARD_WIDTH + rnk.  Rank varies fastest, so moving North is +1
+// and moving East is +BOARD_WIDTH.
+#define FIL_SHIFT 3
+#define FIL_MASK 7
 #define RNK_SHIFT 0
-#define RNK_MASK 0xF
-
-static const uint64_t sq_to_bitmask[100] = {
-0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL,
-0ULL, 1ULL<<0, 1ULL<<1, 1ULL<<2, 1ULL<<3, 1ULL<<4, 1ULL<<5, 1ULL<<6, 1ULL<<7, 0ULL,
-0ULL, 1ULL<<8, 1ULL<<9, 1ULL<<10, 1ULL<<11, 1ULL<<12, 1ULL<<13, 1ULL<<14, 1ULL<<15, 0ULL,
-0ULL, 1ULL<<16, 1ULL<<17, 1ULL<<18, 1ULL<<19, 1ULL<<20, 1ULL<<21, 1ULL<<22, 1ULL<<23, 0ULL,
-0ULL, 1ULL<<24, 1ULL<<25, 1ULL<<26, 1ULL<<27, 1ULL<<28, 1ULL<<29, 1ULL<<30, 1ULL<<31, 0ULL,
-0ULL, 1ULL<<32, 1ULL<<33, 1ULL<<34, 1ULL<<35, 1ULL<<36, 1ULL<<37, 1ULL<<38, 1ULL<<39, 0ULL,
-0ULL, 1ULL<<40, 1ULL<<41, 1ULL<<42, 1ULL<<43, 1ULL<<44, 1ULL<<45, 1ULL<<46, 1ULL<<47, 0ULL,
-0ULL, 1ULL<<48, 1ULL<<49, 1ULL<<50, 1ULL<<51, 1ULL<<52, 1ULL<<53, 1ULL<<54, 1ULL<<55, 0ULL,
-0ULL, 1ULL<<56, 1ULL<<57, 1ULL<<58, 1ULL<<59, 1ULL<<60, 1ULL<<61, 1ULL<<62, 1ULL<<63, 0ULL,
-0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL};
-
-static const int sq_to_bit_index[64] = {
-  11, 12, 13, 14, 15, 16, 17, 18,
-  21, 22, 23, 24, 25, 26, 27, 28,
-  31, 32, 33, 34, 35, 36, 37, 38,
-  41, 42, 43, 44, 45, 46, 47, 48,
-  51, 52, 53, 54, 55, 56, 57, 58,
-  61, 62, 63, 64, 65, 66, 67, 68,
-  71, 72, 73, 74, 75, 76, 77, 78,
-  81, 82, 83, 84, 85, 86, 87, 88,
-};
+#define RNK_MASK 7
+
+// Bitboard holding only square sq
+#define sq_to_bit(sq) (1ULL << (sq))
+
+// Squares on rank 0 / rank 7, used to stop North/South shifts from wrapping
+// into the neighboring file
+#define RNK_0_MASK 0x0101010101010101ULL
+#define RNK_7_MASK 0x8080808080808080ULL
 
 // -----------------------------------------------------------------------------
 // Pieces
@@ -141,8 +123,8 @@ typedef enum {
 
 #define NORTH 1
 #define SOUTH (-1)
-#define EAST ARR_WIDTH
-#define WEST (-ARR_WIDTH)
+#define EAST BOARD_WIDTH
+#define WEST (-BOARD_WIDTH)
 
 static const int dir[NUM_DIR] = {NORTH + WEST, NORTH, NORTH + EAST, EAST,
                                  SOUTH + EAST, SOUTH, SOUTH + WEST, WEST};
@@ -156,15 +138,22 @@ static const int dir[NUM_DIR] = {NORTH + WEST, NORTH, NORTH + EAST, EAST,
 
 typedef enum { NONE, RIGHT, UTURN, LEFT } rot_t;
 
-typedef struct {
-  uint8_t typ: 2;
-  uint8_t rot: 2;
-  square_t from_sq;
-  square_t to_sq;
-} move_t;
+// A move packs into 16 bits:
+//   to_sq (6 bits) | from_sq (6 bits) | rot (2 bits) | ptype (2 bits)
+// so that comparing or hashing two moves is a single integer operation.
+typedef uint16_t move_t;
+
+#define PTYPE_MV_SHIFT 0
+#define PTYPE_MV_MASK 3
+#define ROT_SHIFT 2
+#define ROT_MASK 3
+#define FROM_SHIFT 4
+#define FROM_MASK 0x3F
+#define TO_SHIFT 10
+#define TO_MASK 0x3F
 
-#define NULL_MOVE\
-  (move_t) { (ptype_t)0, (rot_t)0, (square_t)0, (square_t)0 }
+// No real move has ptype EMPTY, so the all-zero encoding is free.
+#define NULL_MOVE ((move_t)0)
 
 typedef uint32_t sort_key_t;
 typedef struct {
@@ -186,29 +175,181 @@ typedef struct victims_t {
 // returned by make move in illegal situation
 #define ILLEGAL_ZAPPED -1
 
+// What a move does once its lasers have fired, as predicted by
+// predict_move() without making the move.  A move that zaps pieces of
+// both colors counts as zapping the enemy.
+typedef enum {
+  EFFECT_QUIET,      // nothing is removed from the board
+  EFFECT_ZAP_ENEMY,  // removes enemy pieces (and maybe some of our own)
+  EFFECT_ZAP_OWN,    // removes only our own pieces (zapped or squashed)
+  EFFECT_SQUASH,     // only squashes an enemy Pawn
+  EFFECT_GAME_OVER   // the resulting position is a game over
+} moveEffect_t;
+
+// What a move would do to the board, worked out by predict_move() without
+// making it: no key, undo record or laser cache is touched.  The search keeps
+// it with the move, so that classifying the move and computing its child's
+// key (key_after()) share one prediction.
+typedef struct move_prediction {
+  piece_t moved;                     // piece on the from-square
+  piece_t pushed;                    // piece on the to-square, or NULL_PIECE
+  square_t push_sq;                  // where `pushed` lands, or BOARD_SIZE
+  square_t hits[MAX_MONARCHS];       // where each beam of the mover stops,
+                                     // or BOARD_SIZE
+  piece_t hit_pieces[MAX_MONARCHS];  // ... and the piece standing there
+  uint8_t effect;                    // moveEffect_t
+} movePrediction_t;
+
+// -----------------------------------------------------------------------------
+// Symmetry
+// -----------------------------------------------------------------------------
+
+// Turning the board by 180 degrees and swapping the colors, and with them the
+// side to move, gives a position that plays exactly like the original: Qi and
+// the laser rules look the same from either side.  sym_square(), sym_piece()
+// and sym_move() map squares, pieces and moves onto that image; each is its
+// own inverse.
+#define sym_square(sq) ((square_t)(BOARD_SIZE - 1 - (sq)))
+#define sym_piece(x) ((piece_t)((x) ^ (COLOR_MASK << COLOR_SHIFT) ^ (2 << ORI_SHIFT)))
+
 // -----------------------------------------------------------------------------
 // Position
 // -----------------------------------------------------------------------------
 
-// Board representation is square-centric with sentinels.
+// Board representation is a set of bitboards, one bit per square.  Each
+// occupied square's piece_t is spread over the bitplanes below: its color
+// (piece_loc), its type (monarchs; every other piece is a Pawn) and its
+// orientation (ori_bits, one plane per bit of ori_of()).  Empty squares are
+// clear in every plane.
 //
-// https://www.chessprogramming.org/Board_Representation
-// https://www.chessprogramming.org/Mailbox
-// https://www.chessprogramming.org/10x12_Board
-
+// https://www.chessprogramming.org/Bitboards
+// https://www.chessprogramming.org/Bitboard_Board-Definition
+
+// Cached laser beams, kept up to date by make_move() and unmake_move().  Slot
+// n of a color belongs to its n-th Monarch in square order.  A beam's path
+// covers the Monarch's own square, every square the beam crosses and the
+// square of the piece it stops on; hit is that piece's square, or BOARD_SIZE
+// if the beam leaves the board.  Unused slots have an empty path.
+typedef struct lasers {
+  uint64_t path[2][MAX_MONARCHS];
+  square_t hit[2][MAX_MONARCHS];
+} lasers_t;
+
+// Partial sums of the evaluation terms that depend only on where pieces stand,
+// per color, kept up to date by make_move() (see eval_acc_update()).  The
+// Pawn terms change by the Pawns a move moves or removes; the Monarch terms
+// and PPROX, which weighs Pawns by their distance to the Monarchs, are summed
+// again only when a Monarch moves, turns or is zapped.
+typedef struct eval_acc {
+  int32_t pmid[2];   // centrality of the Pawns
+  int32_t pprox[2];  // proximity of the Pawns to the Monarchs
+  int32_t mmid[2];   // centrality of the Monarchs
+  int32_t mface[2];  // Monarchs facing the opposing Monarchs
+  int32_t mcede[2];  // room ceded to the opposing Monarchs (as a penalty)
+} evalAcc_t;
+
+// First layer of the network evaluator (nnue.h), kept up to date by
+// make_move() and unmake_move() while the network is in use.  Half c is the
+// layer's output from color c's point of view: the sum of the weights of the
+// features of the board as c sees it (see nnue.c).
+#define NNUE_HIDDEN 64
+
+typedef struct nnue_acc {
+  int16_t half[2][NNUE_HIDDEN];
+} nnueAcc_t;
+
+// Keys of the positions on the line being played or searched, oldest first,
+// for repetition detection.  make_move() pushes the new key and unmake_move()
+// pops it, so the position k ply before p has its key at
+// keys[p->rep_top - k]; only the last nply_since_victim of them can repeat p.
+// filter counts the keys in keys[0 .. rep_top] by their low bits, which rules
+// out a repetition at most nodes without scanning.
+#define REP_HISTORY_SIZE (MAX_PLY_IN_GAME + MAX_PLY_IN_SEARCH)
+#define REP_FILTER_BITS 10
+#define REP_FILTER_MASK ((1 << REP_FILTER_BITS) - 1)
+
+typedef struct rep_history {
+  uint64_t keys[REP_HISTORY_SIZE];
+  uint16_t filter[1 << REP_FILTER_BITS];
+  int played;       // keys[0 .. played] belong to positions actually played
+  bool from_start;  // keys[0] starts the game rather than following a victim
+} repHistory_t;
+
+// Bookkeeping that search nodes seldom read: how the game got here.
+typedef struct position_cold {
+  struct undo* history;  // undo record of the move that led here
+  victims_t victims;     // pieces destroyed by shooter
+  bool was_played;       // TRUE: position was actually played;
+                         // FALSE: position is being considered in search
+} positionCold_t;
+
+// The first cache line holds the board, the key and the counters that
+// make_move() and the evaluator touch at every node; the second holds the
+// evaluation sums and the Pawn key; the third holds the laser cache, the
+// repetition history and the cold bookkeeping.  The network's accumulator
+// comes last, on lines of its own that are left alone unless the network is
+// in use.
 typedef struct position {
-  piece_t board[ARR_SIZE];
-  struct position* history;  // history of position
-  uint64_t key;              // hash key
-  int ply;                // ply since beginning of game (even=White, odd=Black)
-  int nply_since_victim;  // number of ply since last capture
-  move_t last_move;       // move that led to this position
-  victims_t victims;      // pieces destroyed by shooter
-  bool was_played;        // TRUE: position was actually played;
-                          // FALSE: position is being considered in search
   uint64_t piece_loc[2];  // The location of all pieces of each color
-  square_t monarch_loc[2][2];
-} position_t;
+  uint64_t monarchs;      // The location of all Monarchs of either color
+  uint64_t ori_bits[2];   // Bit 0 and bit 1 of each piece's orientation
+  uint64_t key;           // hash key
+  uint64_t sym_key;       // hash key of the symmetric image, see sym_square()
+  int16_t ply;            // ply since beginning of game (even=White, odd=Black)
+  int16_t nply_since_victim;  // number of ply since last capture
+  int16_t rep_top;        // index of this position's key in reps->keys
+  move_t last_move;       // move that led to this position
+
+  evalAcc_t acc __attribute__((aligned(CACHE_LINE_SIZE)));
+                          // evaluation terms summed over the pieces
+  uint64_t pawn_key;      // hash key of the Pawns alone, by color and square
+
+  lasers_t lasers __attribute__((aligned(CACHE_LINE_SIZE)));
+                          // beams of every Monarch on the board
+  repHistory_t* reps;     // keys of this position and the ones before it
+  positionCold_t cold;
+
+  nnueAcc_t nnue __attribute__((aligned(CACHE_LINE_SIZE)));
+} __attribute__((aligned(CACHE_LINE_SIZE))) position_t;
+
+_Static_assert(offsetof(position_t, acc) == CACHE_LINE_SIZE,
+               "position_t: hot fields must fill exactly the first line");
+_Static_assert(offsetof(position_t, lasers) == 2 * CACHE_LINE_SIZE,
+               "position_t: the evaluation sums must fit in the second line");
+_Static_assert(offsetof(position_t, nnue) == 3 * CACHE_LINE_SIZE,
+               "position_t: the laser cache and cold fields must fit in the "
+               "third line");
+_Static_assert(sizeof(position_t) == 3 * CACHE_LINE_SIZE + sizeof(nnueAcc_t),
+               "position_t must span three cache lines and the accumulator");
+
+// Undo record filled in by make_move() and consumed by unmake_move().
+//
+// Moves are made in place, so the record keeps whatever the move destroyed:
+// the pieces it lifted off the board and the scalar state of the position
+// before the move.  Records of consecutive moves are chained through
+// `history`, so the moves that led to a position stay reachable.
+//
+// https://www.chessprogramming.org/Unmake_Move
+typedef struct undo {
+  piece_t moved;     // piece on the from-square before the move
+  piece_t pushed;    // piece on the to-square before the move, or NULL_PIECE
+  square_t push_sq;  // square `pushed` landed on, or BOARD_SIZE if squashed
+  uint8_t num_zapped;
+  piece_t zapped[MAX_MONARCHS];      // pieces removed by lasers
+  square_t zapped_sq[MAX_MONARCHS];  // ... and the squares they stood on
+
+  // Scalar state of the position before the move
+  uint64_t key;
+  uint64_t sym_key;
+  uint64_t pawn_key;
+  struct undo* history;
+  int nply_since_victim;
+  move_t last_move;
+  victims_t victims;
+  bool was_played;
+  lasers_t lasers;
+  evalAcc_t acc;
+} undo_t;
 
 // -----------------------------------------------------------------------------
 // Function prototypes
@@ -221,9 +362,16 @@ __attribute__((always_inline)) color_t opp_color(color_t c);
 void init_zob();
 void print_qi_map();
 uint64_t compute_zob_key(position_t* p);
-void update_piece_loc(position_t* p);
-
-__attribute__((always_inline)) square_t get_monarch(position_t* p, color_t c, int num) ;
+uint64_t compute_sym_key(position_t* p);
+uint64_t compute_pawn_key(position_t* p);
+move_t sym_move(move_t mv);
+
+__attribute__((always_inline)) piece_t piece_at(position_t* p, square_t sq);
+__attribute__((always_inline)) void place_piece(position_t* p, square_t sq, piece_t piece);
+__attribute__((always_inline)) void remove_piece(position_t* p, square_t sq);
+__attribute__((always_inline)) uint64_t monarchs_of(position_t* p, color_t c);
+__attribute__((always_inline)) uint64_t pawns_of(position_t* p, color_t c);
+__attribute__((always_inline)) uint64_t neighbors_of(uint64_t bb);
 __attribute__((always_inline)) square_t square_of(fil_t f, rnk_t r);
 __attribute__((always_inline)) fil_t fil_of(square_t sq);
 __attribute__((always_inline)) rnk_t rnk_of(square_t sq);
@@ -234,6 +382,10 @@ __attribute__((always_inline)) int beam_of(int direction);
 __attribute__((always_inline)) int reflect_of(int beam_dir, int pawn_ori);
 
 __attribute__((always_inline)) move_t move_of(ptype_t typ, rot_t rot, square_t from_sq, square_t to_sq);
+__attribute__((always_inline)) ptype_t ptype_mv_of(move_t mv);
+__attribute__((always_inline)) square_t from_square(move_t mv);
+__attribute__((always_inline)) square_t to_square(move_t mv);
+__attribute__((always_inline)) rot_t rot_of(move_t mv);
 void move_to_str(move_t mv, char* buf, size_t bufsize);
 __attribute__((always_inline)) bool move_eq(move_t a, move_t b);
 bool sortable_move_seq(sortable_move_t a, sortable_move_t b);
@@ -242,25 +394,30 @@ __attribute__((always_inline)) uint8_t qi_at(square_t sq);
 __attribute__((always_inline)) bool qi_at_dest_is_higher(square_t src, square_t dest);
 
 
-__attribute__((always_inline)) square_t fire_lasers(position_t* p, color_t c);
-square_t fire_laser(position_t* p, square_t monarch_loc);
-void mark_laser_map(position_t* p, color_t c, square_t sq);
+__attribute__((always_inline)) int fire_lasers(position_t* p, color_t c);
+void update_lasers(position_t* p);
 
 int generate_all(position_t* p, sortable_move_t* sortable_move_list);
+int generate_all_scalar(position_t* p, sortable_move_t* sortable_move_list);
+bool is_pseudo_legal(position_t* p, move_t mv);
 __attribute__((always_inline)) int generate_all_with_color(position_t* p, sortable_move_t* sortable_move_list,
                             color_t color_to_move);
 void do_perft(position_t* gme, int depth);
-void low_level_make_move(position_t* old, position_t* p, move_t mv);
-victims_t make_move(position_t* old, position_t* p, move_t mv);
+void do_perft_divide(position_t* gme, int depth);
+void do_laser_bench(position_t* p, int iterations, bool beams_only);
+void low_level_make_move(position_t* p, move_t mv, undo_t* u);
+victims_t make_move(position_t* p, move_t mv, undo_t* u);
+void predict_move(position_t* p, move_t mv, movePrediction_t* pred);
+uint64_t key_after(position_t* p, move_t mv, const movePrediction_t* pred,
+                   uint64_t* sym_key);
+void unmake_move(position_t* p, undo_t* u);
+void rep_history_init(position_t* p, repHistory_t* r);
+void rep_history_fork(position_t* p, repHistory_t* r);
 
 //For leiserchess.c
-victims_t actually_make_move(position_t* old, position_t* p, move_t mv);
+victims_t actually_make_move(position_t* p, move_t mv, undo_t* u);
 void display(position_t* p);
 void bitboardDisplay(position_t* p);
-// void laserMapDisplay(position_t* p);
-
-void laser_coverage_make_move(position_t* pos, move_t mv, piece_t* previous_pieces);
-void laser_coverage_unmake_move(position_t *pos, move_t mv, piece_t *previous_pieces);
 
 victims_t ILLEGAL();
 bool is_ILLEGAL(victims_t victims);
@@ -0,0 +1,217 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#include "nnue.h"
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "tbassert.h"
+
+_Static_assert(NNUE_HIDDEN % 32 == 0,
+               "clipped_dot() works on 32 outputs of the first layer at a time");
+
+int USE_NNUE;
+
+// Largest score nnue_eval() returns, well clear of the win scores
+#define NNUE_MAX_SCORE (100 * PAWN_VALUE)
+
+typedef struct {
+  int32_t scale;
+  int16_t ft_bias[NNUE_HIDDEN];
+  int16_t ft_weights[NNUE_FEATURES][NNUE_HIDDEN];
+  int8_t out_weights[2 * NNUE_HIDDEN];
+  int32_t out_bias;
+} __attribute__((aligned(32))) net_t;
+
+static net_t net;
+static bool net_loaded;
+
+// -----------------------------------------------------------------------------
+// Weights file
+// -----------------------------------------------------------------------------
+
+// Reads n items of size bytes each, and fails unless all of them were there
+static bool read_all(FILE* f, void* buf, size_t size, size_t n) {
+  return fread(buf, size, n, f) == n;
+}
+
+// The file is read as is, so this only works on little-endian hosts, which is
+// all the engine is built for.
+int nnue_load(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return 1;
+  }
+
+  net_t* tmp;
+  if (posix_memalign((void**)&tmp, 32, sizeof(net_t)) != 0) {
+    fclose(f);
+    return 1;
+  }
+
+  char magic[4];
+  uint32_t header[3];
+  char extra;
+  bool ok = read_all(f, magic, 1, 4) && memcmp(magic, "LCNN", 4) == 0 &&
+            read_all(f, header, sizeof(uint32_t), 3) &&
+            header[0] == NNUE_VERSION && header[1] == NNUE_FEATURES &&
+            header[2] == NNUE_HIDDEN &&
+            read_all(f, &tmp->scale, sizeof(int32_t), 1) &&
+            read_all(f, tmp->ft_bias, sizeof(int16_t), NNUE_HIDDEN) &&
+            read_all(f, tmp->ft_weights, sizeof(int16_t),
+                     NNUE_FEATURES * NNUE_HIDDEN) &&
+            read_all(f, tmp->out_weights, sizeof(int8_t), 2 * NNUE_HIDDEN) &&
+            read_all(f, &tmp->out_bias, sizeof(int32_t), 1) &&
+            fread(&extra, 1, 1, f) == 0;  // nothing may follow
+  fclose(f);
+
+  if (ok) {
+    net = *tmp;
+    net_loaded = true;
+  }
+  free(tmp);
+  return ok ? 0 : 1;
+}
+
+bool nnue_loaded() { return net_loaded; }
+
+// -----------------------------------------------------------------------------
+// First layer
+// -----------------------------------------------------------------------------
+
+// Feature for piece x on sq as seen by color persp.  Black sees the board
+// turned around, as sym_square() and sym_piece() do it, so that both halves
+// of the accumulator share one set of weights and the side a half is for is
+// always the white, "own", pieces of the features.
+static int feature(color_t persp, square_t sq, piece_t x) {
+  if (persp == BLACK) {
+    sq = sym_square(sq);
+    x = sym_piece(x);
+  }
+  int kind = (color_of(x) << 3) | ((ptype_of(x) == MONARCH) << 2) | ori_of(x);
+  return sq * NNUE_KINDS + kind;
+}
+
+// Adds (sign 1) or takes away (sign -1) x on sq in both halves
+static void acc_piece(nnueAcc_t* acc, square_t sq, piece_t x, int sign) {
+  for (color_t c = 0; c <= 1; c++) {
+    const int16_t* w = net.ft_weights[feature(c, sq, x)];
+    int16_t* h = acc->half[c];
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+      h[i] += sign * w[i];
+    }
+  }
+}
+
+static void refresh(position_t* p, nnueAcc_t* acc) {
+  for (color_t c = 0; c <= 1; c++) {
+    memcpy(acc->half[c], net.ft_bias, sizeof(net.ft_bias));
+  }
+  for (uint64_t b = p->piece_loc[WHITE] | p->piece_loc[BLACK]; b;
+       b &= b - 1) {
+    square_t sq = __builtin_ctzll(b);
+    acc_piece(acc, sq, piece_at(p, sq), 1);
+  }
+}
+
+void nnue_refresh(position_t* p) { refresh(p, &p->nnue); }
+
+// Applies the changes to the board that p->last_move, recorded in u, made,
+// forward (sign 1) or backward (sign -1).  Everything needed comes from u and
+// the move, not from the board, so the same works before and after
+// unmake_move() puts the pieces back.
+static void apply_move(position_t* p, const undo_t* u, int sign) {
+  square_t from_sq = from_square(p->last_move);
+  square_t to_sq = to_square(p->last_move);
+
+  acc_piece(&p->nnue, from_sq, u->moved, -sign);
+  if (from_sq != to_sq) {
+    acc_piece(&p->nnue, to_sq, u->moved, sign);
+    if (u->pushed != NULL_PIECE) {
+      acc_piece(&p->nnue, to_sq, u->pushed, -sign);
+      if (u->push_sq < BOARD_SIZE) {
+        acc_piece(&p->nnue, u->push_sq, u->pushed, sign);
+      }
+    }
+  } else {
+    piece_t turned = u->moved;
+    set_ori(&turned, (uint8_t)((rot_of(p->last_move) + ori_of(u->moved)) %
+                               NUM_ORI));
+    acc_piece(&p->nnue, from_sq, turned, sign);
+  }
+
+  for (int n = 0; n < u->num_zapped; n++) {
+    acc_piece(&p->nnue, u->zapped_sq[n], u->zapped[n], -sign);
+  }
+}
+
+void nnue_update(position_t* p, const undo_t* u) { apply_move(p, u, 1); }
+
+void nnue_revert(position_t* p, const undo_t* u) { apply_move(p, u, -1); }
+
+// -----------------------------------------------------------------------------
+// Output layer
+// -----------------------------------------------------------------------------
+
+// Sum of w[i] * h[i] over the half h clipped to [0, NNUE_QA]
+static int32_t clipped_dot(const int16_t* h, const int8_t* w) {
+#ifdef __AVX2__
+  const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+    __m256i a = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)&h[i]), qa);
+    __m256i b =
+        _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)&h[i + 16]), qa);
+    // packus saturates the negatives to 0 but interleaves the 128-bit lanes
+    __m256i x = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+    __m256i wv = _mm256_loadu_si256((const __m256i*)&w[i]);
+    // Pairs of products fit in 16 bits: 2 * NNUE_QA * 127 < 32768
+    sum = _mm256_add_epi32(sum,
+                           _mm256_madd_epi16(_mm256_maddubs_epi16(x, wv), ones));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < NNUE_HIDDEN; i++) {
+    int32_t x = h[i] < 0 ? 0 : (h[i] > NNUE_QA ? NNUE_QA : h[i]);
+    sum += x * w[i];
+  }
+  return sum;
+#endif
+}
+
+score_t nnue_eval(position_t* p) {
+  tbassert(net_loaded, "nnue_eval: no weights loaded\n");
+
+  #ifndef NDEBUG
+    nnueAcc_t fresh;
+    refresh(p, &fresh);
+    tbassert(memcmp(&fresh, &p->nnue, sizeof(fresh)) == 0,
+             "nnue accumulator is stale\n");
+  #endif
+
+  color_t us = color_to_move_of(p);
+  int64_t out = net.out_bias;
+  out += clipped_dot(p->nnue.half[us], net.out_weights);
+  out += clipped_dot(p->nnue.half[opp_color(us)], net.out_weights + NNUE_HIDDEN);
+
+  int64_t cp = out * net.scale / (NNUE_QA * NNUE_QB);
+  if (cp > NNUE_MAX_SCORE) {
+    cp = NNUE_MAX_SCORE;
+  } else if (cp < -NNUE_MAX_SCORE) {
+    cp = -NNUE_MAX_SCORE;
+  }
+  return (score_t)cp;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Network evaluator: an alternative to the heuristics of eval.c, selected by
+// the use_nnue option.
+//
+// A small quantized network in the style of NNUE.  Its inputs are the pieces
+// of the board, one feature per square, piece type, orientation and side, and
+// its first layer is kept incrementally in p->nnue by make_move() and
+// unmake_move(), so an evaluation only runs the output layer.
+//
+// https://www.chessprogramming.org/NNUE
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "move_gen.h"
+#include "search.h"
+
+// One feature per square and kind of piece: own or opposing, Pawn or Monarch,
+// and orientation, as seen by the side the half of the accumulator is for
+#define NNUE_KINDS 16
+#define NNUE_FEATURES (BOARD_SIZE * NNUE_KINDS)
+
+// Fixed-point scales: the first layer's weights and outputs are in units of
+// 1 / NNUE_QA and are clipped to [0, NNUE_QA] before the output layer, whose
+// weights are in units of 1 / NNUE_QB.
+#define NNUE_QA 127
+#define NNUE_QB 64
+
+// Weights file written by `training/project4_training_script.py --nnue`, all
+// values little-endian:
+//   char    magic[4]        "LCNN"
+//   uint32  version         NNUE_VERSION
+//   uint32  features        NNUE_FEATURES
+//   uint32  hidden          NNUE_HIDDEN
+//   int32   scale           centipawns per unit of the network's output
+//   int16   ft_bias[NNUE_HIDDEN]
+//   int16   ft_weights[NNUE_FEATURES][NNUE_HIDDEN]
+//   int8    out_weights[2 * NNUE_HIDDEN]   side to move first
+//   int32   out_bias
+#define NNUE_VERSION 1
+
+// Read at startup from $LEISERCHESS_NNUE, or from this file in the working
+// directory if that is not set
+#define NNUE_DEFAULT_FILE "leiserchess.nnue"
+
+// Nonzero: eval() asks the network.  Can only be set once weights are loaded.
+extern int USE_NNUE;
+
+// Loads the weights in path.  Returns 0 on success; on failure the weights
+// loaded before, if any, are kept.
+int nnue_load(const char* path);
+bool nnue_loaded();
+
+// Works out p->nnue from scratch
+void nnue_refresh(position_t* p);
+// Updates p->nnue for the move make_move() just made and recorded in u
+void nnue_update(position_t* p, const undo_t* u);
+// Takes that update back; called by unmake_move() before p->last_move is
+// restored
+void nnue_revert(position_t* p, const undo_t* u);
+
+// Score of p from the point of view of the side to move
+score_t nnue_eval(position_t* p);
+
+#endif  // NNUE_H
@@ -23,6 +23,7 @@ extern int LMR_R2;
 extern int HMB;
 extern int USE_NMM;
 extern int FUT_DEPTH;
+extern int LAZY_MARGIN;
 extern int TRACE_MOVES;
 extern int DETECT_DRAWS;
 extern int NMOVES_DRAW;
@@ -38,11 +39,20 @@ extern int MMID_weight;
 extern int PMID_weight;
 extern int RELQI_weight;
 extern int ABSQI_weight;
+extern int EVAL_CACHE;
+extern int PAWN_HASH;
 
 // defined in tt.c
 extern int USE_TT;
+extern int USE_SYMMETRY;
 extern int HASH;
 
+// defined in move_gen.c
+extern int PERFT_HASH;
+
+// defined in nnue.c
+extern int USE_NNUE;
+
 // flag that can be set via uci setoption command that will reset the rng to
 // default
 //   seeds. This is useful for running benchmarks for changes that only impact
@@ -83,6 +93,9 @@ static int_options iopts[] = {
     {"absqi", &ABSQI_weight, (int)(0.0106 * P_EV_VAL), DEFAULT_MIN,
      DEFAULT_MAX},
     {"hash", &HASH, 300, 1, MAX_HASH},
+    {"perft_hash", &PERFT_HASH, 64, 0, MAX_HASH},
+    {"evalcache", &EVAL_CACHE, 8, 0, MAX_HASH},
+    {"pawnhash", &PAWN_HASH, 4, 0, MAX_HASH},
     {"draw", &DRAW, (int)(-0.0016 * PAWN_VALUE), -PAWN_VALUE, PAWN_VALUE},
     {"randomize", &RANDOMIZE, 0, 0, P_EV_VAL},
     {"reset_rng", &RESET_RNG, 0, 0, 1},
@@ -90,10 +103,13 @@ static int_options iopts[] = {
     {"lmr_r2", &LMR_R2, 20, 1, MAX_NUM_MOVES},
     {"hmb", &HMB, (int)(0.0027 * PAWN_VALUE), 0, PAWN_VALUE},
     {"fut_depth", &FUT_DEPTH, 3, 0, 5},
+    {"lazy_margin", &LAZY_MARGIN, 0, 0, 10 * PAWN_VALUE},
+    {"use_nnue", &USE_NNUE, 0, 0, 1},
     // debug options
     {"use_nmm", &USE_NMM, 1, 0, 1},
     {"detect_draws", &DETECT_DRAWS, 1, 0, 1},
     {"use_tt", &USE_TT, 1, 0, 1},
+    {"use_symmetry", &USE_SYMMETRY, 0, 0, 1},
     {"use_ob", &USE_OB, 0, 0, 1},
     {"trace_moves", &TRACE_MOVES, 0, 0, 1},
     {"nmoves_draw", &NMOVES_DRAW, 100, 1, 1000 * 1000},
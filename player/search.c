@@ -60,6 +60,9 @@ int NMOVES_DRAW;   // Number of contiguous non-capture moves after which a draw
 // do not set more than 5 ply
 int FUT_DEPTH;  // set to zero for no futilty
 
+// most the terms eval_lazy() leaves out are taken to be worth
+int LAZY_MARGIN;  // set to zero for no lazy evaluation
+
 // From search_scout.c
 static score_t searchPV(searchNode* node, int depth,
                         uint64_t* node_count_serial);
@@ -83,16 +86,17 @@ static void getPV(bestMove* pv, char* buf, size_t bufsize);
 static void print_move_info(move_t mv, int ply, position_t* pos);
 static leafEvalResult evaluate_as_leaf(searchNode* node, searchType_t type);
 static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
+                                         const movePrediction_t* pred,
                                          move_t killer_a, move_t killer_b,
                                          searchType_t type,
                                          uint64_t* node_count_serial);
-static void sort_insertion(sortable_move_t* move_list, int num_of_moves);
 static bool search_process_score(searchNode* node, move_t mv, int mv_index,
                                  moveEvaluationResult* result,
                                  searchType_t type);
 static bool should_abort_check();
-static int get_sortable_move_list(searchNode* node, sortable_move_t* move_list, move_t hash_table_move);
-static int get_sortable_move_list_partial(searchNode* node, sortable_move_t* move_list, move_t hash_table_move);
+static void init_move_picker(movePicker* mp, searchNode* node,
+                             move_t hash_table_move, bool partial);
+static move_t next_move(movePicker* mp, const movePrediction_t** pred);
 // Include common search functions
 #include "./search_common.c"
 #include "./search_globals.c"
@@ -109,7 +113,7 @@ static void initialize_pv_node(searchNode* node, int depth) {
   node->depth = depth;
   node->legal_move_count = 0;
   node->ply = node->parent->ply + 1;
-  node->fake_color_to_move = color_to_move_of(&(node->position));
+  node->fake_color_to_move = color_to_move_of(node->position);
   // point of view = 1 for White, -1 for Black
   node->pov = 1 - node->fake_color_to_move * 2;
   node->quiescence = (depth <= 0);
@@ -149,64 +153,54 @@ static score_t searchPV(searchNode* node, int depth,
   move_t killer_a = node->killer[KMT(node->ply, 0)];
   move_t killer_b = node->killer[KMT(node->ply, 1)];
 
-  // sortable_move_t move_list
-  //
-  // Contains a list of possible moves at this node. These moves are "sortable"
-  //   and can be compared as integers. This is accomplished by using high-order
-  //   bits to store a sort key. To get a better idea of what these sort keys
-  //   mean, look at the get_sortable_move_list function in search_common.c.
-  //
-  // Keep track of the number of moves that we have considered at this node.
-  //   After we finish searching moves at this node the move_list array will
-  //   be organized in the following way:
+  // movePicker picker
   //
-  //   m0, m1, ... , m_k-1, m_k, ... , m_N-1
+  // Hands out the moves of this node one at a time, best first, generating
+  //   them only if the hash move and the killers do not cause a cutoff. See
+  //   movePicker in search.h and next_move in search_common.c.
   //
-  //  where k = num_moves_tried, and N = num_of_moves
-  //
-  //  This will allow us to update the best_move_history table easily by
-  //  scanning move_list from index 0 to k such that we update the table
-  //  only for moves that we actually considered at this node.
-
-  sortable_move_t move_list_with_sentinel[MAX_NUM_MOVES];
-  move_list_with_sentinel[0].key = MAX_SORT_KEY;
-  sortable_move_t* move_list = move_list_with_sentinel + 1;
-  int num_of_moves = get_sortable_move_list(node, move_list, hash_table_move);
+  // Keep track of the moves that we have considered at this node in `tried`,
+  //   in the order they were searched, so that the best_move_history table
+  //   is only updated for moves that we actually considered at this node.
+  movePicker picker;
+  init_move_picker(&picker, node, hash_table_move, false);
   int num_moves_tried = 0;
 
-  // Insertion sort the move list
-  sort_insertion(move_list_with_sentinel, num_of_moves + 1);
-
   // Start searching moves
   sortable_move_t deferred[MAX_NUM_MOVES];
   sortable_move_t tried[MAX_NUM_MOVES];
   int deferred_count = 0;
   bool isFirst = true;
-  sortable_move_t* moves = move_list;
-
-  for (int abd_pass = 0; abd_pass <2; abd_pass++) {
-    int move_count = (abd_pass == 0) ? num_of_moves : deferred_count;
-    for (int mv_index = 0; mv_index < move_count; mv_index++) {
-      move_t mv = get_move(moves[mv_index]);
-      if (abd_pass == 0 && is_move_searching(node->position.key, mv) && !isFirst) {
+  bool cutoff = false;
+
+  for (int abd_pass = 0; abd_pass < 2 && !cutoff; abd_pass++) {
+    for (int mv_index = 0;; mv_index++) {
+      const movePrediction_t* pred = NULL;  // none for deferred moves
+      move_t mv = (abd_pass == 0) ? next_move(&picker, &pred)
+                  : (mv_index < deferred_count) ? deferred[mv_index].mv
+                                                : NULL_MOVE;
+      if (move_eq(mv, NULL_MOVE)) {
+        break;
+      }
+      if (abd_pass == 0 && is_move_searching(node->position->key, mv) && !isFirst) {
         deferred[deferred_count++].mv =mv;
         isFirst = false;
         continue;
       }
       tried[num_moves_tried++].mv = mv;
-      set_search_move(node->position.key, mv);
+      set_search_move(node->position->key, mv);
       isFirst = false;
 
       (*node_count_serial) ++;
 
       if (TRACE_MOVES) {
-        print_move_info(mv, node->ply, &node->position);
+        print_move_info(mv, node->ply, node->position);
       }
 
-      // printf("calling from searchPV \n");
-      moveEvaluationResult result = evaluateMove(node, mv, killer_a, killer_b,
-                                                SEARCH_PV, node_count_serial);
-      finish_search(node->position.key, mv);
+      moveEvaluationResult result = evaluateMove(node, mv, pred, killer_a,
+                                                 killer_b, SEARCH_PV,
+                                                 node_count_serial);
+      finish_search(node->position->key, mv);
 
       if (result.type == MOVE_ILLEGAL || result.type == MOVE_IGNORE) {
         continue;
@@ -223,18 +217,17 @@ static score_t searchPV(searchNode* node, int depth,
         return 0;
       }
 
-      bool cutoff = search_process_score(node, mv, mv_index, &result, SEARCH_PV);
+      cutoff = search_process_score(node, mv, num_moves_tried - 1, &result,
+                                    SEARCH_PV);
       if (cutoff) {
         break;
       }
     }
-    moves  = deferred;
   }
 
   if (node->quiescence == false) {
-    update_best_move_history(&(node->position), node->best_move_index,
-                            //  move_list, num_moves_tried);
-                            tried, num_moves_tried, node->best_move_history);
+    update_best_move_history(node->position, node->best_move_index,
+                             tried, num_moves_tried, node->best_move_history);
   }
 
   tbassert(abs(node->best_score) != -INF, "best_score = %d\n",
@@ -243,7 +236,7 @@ static score_t searchPV(searchNode* node, int depth,
   // Update the transposition table.
   //
   // Note: This function reads node->best_score, node->orig_alpha,
-  //   node->position.key, node->depth, node->ply, node->beta,
+  //   node->position->key, node->depth, node->ply, node->beta,
   //   node->alpha, node->subpv
   update_transposition_table(node);
   return node->best_score;
@@ -261,8 +254,8 @@ static void initialize_root_node(searchNode* node, score_t alpha, score_t beta,
   node->beta = beta;
   node->depth = depth;
   node->ply = ply;
-  node->position = *p;
-  node->fake_color_to_move = color_to_move_of(&(node->position));
+  node->position = p;
+  node->fake_color_to_move = color_to_move_of(node->position);
   node->best_score = -INF;
   node->pov =
       1 - node->fake_color_to_move * 2;  // pov = 1 for White, -1 for Black
@@ -273,61 +266,83 @@ static void initialize_root_node(searchNode* node, score_t alpha, score_t beta,
 
 score_t searchRoot(position_t* p, score_t alpha, score_t beta, int depth,
                    int ply, bestMove* pv, uint64_t* node_count_serial,
-                   FILE* OUT, int thread, sortable_move_t move_list[MAX_NUM_MOVES], move_t* killer, int* best_move_history) {
-  static int num_of_moves = 0;  // number of moves in list
-  // hopefully, more than we will need
-  // static sortable_move_t move_list[MAX_NUM_MOVES];
-
+                   FILE* OUT, int thread, sortable_move_t move_list[MAX_NUM_MOVES], int* num_moves,
+                   move_t* killer, int* best_move_history, uint64_t* rng) {
+  // move_list and *num_moves belong to the caller, so searches of different
+  // positions can run at once.  The moves are shuffled with splitmix64(rng),
+  // or with myrand() if rng is NULL.
   if (depth == 1) {
     // we are at depth 1; generate all possible moves
-    num_of_moves = generate_all(p, move_list);
+    *num_moves = generate_all(p, move_list);
     // shuffle the list of moves
-    for (int i = 0; i < num_of_moves; i++) {
-      int r = myrand() % num_of_moves;
+    for (int i = 0; i < *num_moves; i++) {
+      int r = (rng != NULL ? splitmix64(rng) : myrand()) % *num_moves;
       sortable_move_t tmp = move_list[i];
       move_list[i] = move_list[r];
       move_list[r] = tmp;
     }
   }
 
+  // The whole search of this thread runs on this one position: moves are
+  // made and taken back in place, with a repetition history of its own.
+  position_t position = *p;
+  repHistory_t reps;
+  rep_history_fork(&position, &reps);
+
+  // Row i of the PV table holds the line found by the node i ply below the
+  // root.
+  move_t pv_table[MAX_PLY_IN_SEARCH][MAX_PLY_IN_SEARCH];
+
   searchNode rootNode;
   rootNode.parent = NULL;
-  initialize_root_node(&rootNode, alpha, beta, depth, ply, p, killer, best_move_history);
+  rootNode.subpv = pv_table[0];
+  initialize_root_node(&rootNode, alpha, beta, depth, ply, &position, killer, best_move_history);
 
   tbassert(rootNode.best_score == alpha, "root best score not equal alpha");
 
   searchNode next_node;
+  next_node.subpv = pv_table[1];
   next_node.subpv[0] = NULL_MOVE;
   next_node.parent = &rootNode;
+  next_node.position = &position;
 
   score_t score;
+  undo_t undo;
 
+  const int num_of_moves = *num_moves;
   for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
     move_t mv = get_move(move_list[mv_index]);
 
     if (TRACE_MOVES) {
-      print_move_info(mv, ply, &rootNode.position);
+      print_move_info(mv, ply, &position);
     }
 
     (*node_count_serial)++;
 
-    // make the move.
-    // printf("Calling from searchRoot \n");
-    victims_t x = make_move(&(rootNode.position), &(next_node.position), mv);
+    // make the move, while the child's transposition table set and eval cache
+    // entry load.
+    uint64_t child_sym_key;
+    movePrediction_t pred;
+    predict_move(&position, mv, &pred);
+    uint64_t child_key = key_after(&position, mv, &pred, &child_sym_key);
+    tt_prefetch(tt_key(child_key, child_sym_key));
+    eval_cache_prefetch(child_key);
+    victims_t x = make_move(&position, mv, &undo);
 
     if (is_ILLEGAL(x)) {
+      unmake_move(&position, &undo);
       continue;  // not a legal move
     }
 
-    if (is_end_game_position(&(next_node.position))) {
+    if (is_end_game_position(&position)) {
       score =
-          get_end_game_score(&(next_node.position), rootNode.pov, rootNode.ply);
+          get_end_game_score(&position, rootNode.pov, rootNode.ply);
       next_node.subpv[0] = NULL_MOVE;
       goto scored;
     }
 
-    if (is_draw(&(next_node.position))) {
-      score = get_draw_score(&(next_node.position), rootNode.ply);
+    if (is_draw(&position)) {
+      score = get_draw_score(&position, rootNode.ply);
       next_node.subpv[0] = NULL_MOVE;
       goto scored;
     }
@@ -359,6 +374,8 @@ score_t searchRoot(position_t* p, score_t alpha, score_t beta, int depth,
     }
 
   scored:
+    unmake_move(&position, &undo);
+
     // only valid for the root node:
     tbassert((score > rootNode.best_score) == (score > rootNode.alpha),
              "score = %d, best = %d, alpha = %d\n", score, rootNode.best_score,
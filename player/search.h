@@ -36,9 +36,9 @@
 // https://www.chessprogramming.org/History_Heuristic
 //
 // FORMAT: best_move_history[color_t][piece_t][square_t][orientation]
-#define __BMH_dim__ [2 * 6 * ARR_SIZE * NUM_ORI]  // NOLINT(whitespace/braces)
+#define __BMH_dim__ [2 * 6 * BOARD_SIZE * NUM_ORI]  // NOLINT(whitespace/braces)
 #define BMH(color, piece, square, ori) \
-  (color * 6 * ARR_SIZE * NUM_ORI + piece * ARR_SIZE * NUM_ORI + square * NUM_ORI + ori)
+  (color * 6 * BOARD_SIZE * NUM_ORI + piece * BOARD_SIZE * NUM_ORI + square * NUM_ORI + ori)
 
 typedef int16_t score_t;  // Search uses "low res" values
 
@@ -49,26 +49,36 @@ typedef enum searchType {  // different types of search
   SEARCH_SCOUT
 } searchType_t;
 
+// The first cache line holds what every node reads or writes while it
+// searches its moves; the second holds per-node bookkeeping.  The principal
+// variation lives outside the node: subpv is this node's row of its thread's
+// PV table, and the row of a child follows directly after it.
 typedef struct searchNode {
   struct searchNode* parent;
-  searchType_t type;
+  position_t* position;  // shared by every node of a thread's search
+  move_t* subpv;
+  move_t* killer;
+  int* best_move_history;
   score_t orig_alpha;
   score_t alpha;
   score_t beta;
+  score_t best_score;
   int depth;
   int ply;
-  color_t fake_color_to_move;
-  int quiescence;
   int pov;
+  searchType_t type;
+
+  int quiescence;
   int legal_move_count;
-  bool abort;
-  score_t best_score;
   int best_move_index;
-  position_t position;
-  move_t subpv[MAX_PLY_IN_SEARCH];
-  move_t* killer;
-  int* best_move_history;
-} searchNode;
+  color_t fake_color_to_move;
+  bool abort;
+} __attribute__((aligned(CACHE_LINE_SIZE))) searchNode;
+
+_Static_assert(offsetof(searchNode, quiescence) == CACHE_LINE_SIZE,
+               "searchNode: hot fields must fill exactly the first line");
+_Static_assert(sizeof(searchNode) == 2 * CACHE_LINE_SIZE,
+               "searchNode must span exactly two cache lines");
 
 void init_tics();
 void init_abort_timer(double goal_time);
@@ -79,6 +89,47 @@ void reset_abort();
 bool is_draw(position_t* p);
 move_t get_move(sortable_move_t sortable_mv);
 
+// Staged move picker.  Hands out the moves of a node one at a time, best
+// first, generating moves only when the hash move and killers have not
+// produced a cutoff:
+//
+//   1. the hash move, then the two killers, each only if is_pseudo_legal();
+//   2. moves that zap or squash an enemy piece, or end the game, as told by
+//      predict_move();
+//   3. the remaining moves -- quiet moves and blunders -- which quiescence
+//      would ignore anyway, so it skips them entirely.
+//
+// Within stages 2 and 3 moves come out in best_move_history order, picked
+// lazily one at a time, each with the prediction that sorted it into its
+// stage, so that evaluateMove() need not predict it again.
+//
+// https://www.chessprogramming.org/Move_Generation#Staged_Move_Generation
+typedef enum {
+  PICK_HASH,
+  PICK_KILLER_A,
+  PICK_KILLER_B,
+  PICK_GENERATE,
+  PICK_ZAPPING,
+  PICK_QUIET,
+  PICK_DONE
+} pickStage_t;
+
+typedef struct movePicker {
+  position_t* position;
+  pickStage_t stage;
+  move_t hash_move;
+  move_t killer_a;
+  move_t killer_b;
+  bool quiescence;  // stop after the zapping moves
+  bool partial;     // history scores below 5 count as 0 (scout search)
+  int* best_move_history;
+  int num_zapping;  // moves[0 .. num_zapping) zap the enemy
+  int num_moves;    // moves[num_zapping .. num_moves) do not
+  int next;         // next move of the current stage
+  sortable_move_t moves[MAX_NUM_MOVES];
+  movePrediction_t preds[MAX_NUM_MOVES];  // preds[i] belongs to moves[i]
+} movePicker;
+
 typedef struct bestMove {
   int score;
   move_t move;
@@ -87,7 +138,8 @@ typedef struct bestMove {
 } bestMove;
 
 score_t searchRoot(position_t* p, score_t alpha, score_t beta, int depth, int ply, bestMove* pv,
-                   uint64_t* node_count_serial, FILE* OUT, int thread, sortable_move_t move_list[MAX_NUM_MOVES], move_t* killer, int* best_move_history);
+                   uint64_t* node_count_serial, FILE* OUT, int thread, sortable_move_t move_list[MAX_NUM_MOVES],
+                   int* num_moves, move_t* killer, int* best_move_history, uint64_t* rng);
 
 typedef enum { MOVE_EVALUATED, MOVE_ILLEGAL, MOVE_IGNORE, MOVE_GAMEOVER } moveEvaluationResult_t;
 
@@ -21,7 +21,6 @@ static score_t fmarg[10] = {0,
                             PAWN_VALUE * 20,
                             PAWN_VALUE * 30};
 
-static const uint64_t MAX_SORT_KEY = (1ULL << 32) - 1;
 
 void init_abort_timer(double goal_time) {
   sstart = milliseconds();
@@ -39,29 +38,23 @@ void init_tics() { tics = 0; }
 
 move_t get_move(sortable_move_t sortable_mv) { return sortable_mv.mv; }
 
+// Scores a draw found by is_draw(): a repetition scores DRAW for the side that
+// made it, anything else (too many moves without a victim) scores 0.
 static score_t get_draw_score(position_t* p, int ply) {
-  position_t* x = p->history;
-  uint64_t cur = p->key;
-  score_t score;
-  while (true) {
-    if (!zero_victims(x->victims)) {
-      break;  // cannot be a repetition
-    }
-    x = x->history;
-    if (!zero_victims(x->victims)) {
-      break;  // cannot be a repetition
-    }
-    if (x->key == cur) {  // is a repetition
-      if (ply & 1) {
-        score = -DRAW;
-      } else {
-        score = DRAW;
-      }
-      return score;
+  const repHistory_t* r = p->reps;
+  const uint64_t cur = p->key;
+
+  // The position right after the last victim is not matched, unless no victim
+  // precedes it because it starts the game.
+  int oldest = p->rep_top - p->nply_since_victim;
+  if (oldest > 0 || !r->from_start) {
+    oldest++;
+  }
+  for (int i = p->rep_top - 2; i >= oldest; i -= 2) {
+    if (r->keys[i] == cur) {  // is a repetition
+      return (ply & 1) ? -DRAW : DRAW;
     }
-    x = x->history;
   }
-  // assert(false);  // This should not occur.
   return (score_t)0;
 }
 
@@ -76,27 +69,30 @@ bool is_draw(position_t* p) {
     return true;
   }
 
-  // Check whether this move has been repeated at least DRAW_NUM_REPS times over
-  // the history of the game or 2x within the search
+  // Nothing else on the line shares the low bits of p's key
+  const repHistory_t* r = p->reps;
   const uint64_t cur = p->key;
+  if (r->filter[cur & REP_FILTER_MASK] < 2) {
+    return false;
+  }
+
+  // Check whether this move has been repeated at least DRAW_NUM_REPS times over
+  // the history of the game or 2x within the search.  Only positions with the
+  // same side to move, an even number of ply back, can repeat this one.
   size_t reps_history = 1;
   size_t reps_search = 0;
 
-  if (!p->was_played) {
+  if (!p->cold.was_played) {
     reps_search++;
   }
-  int nply_since_victim = p->nply_since_victim - 2;
-
-  while (nply_since_victim >= 0) {
-    nply_since_victim -= 2;
-    p = p->history->history;
-    const bool isSameBoard = p->key == cur;
-    if (isSameBoard) {
-      reps_history ++;
-      if (!(p->was_played)) {
-        reps_search ++;
+  const int oldest = p->rep_top - p->nply_since_victim;
+  for (int i = p->rep_top - 2; i >= oldest; i -= 2) {
+    if (r->keys[i] == cur) {
+      reps_history++;
+      if (i > r->played) {
+        reps_search++;
       }
-    };
+    }
   }
   if ((reps_history >= DRAW_NUM_REPS) || (reps_search >= 2)) {
     return true;
@@ -125,12 +121,18 @@ static void print_move_info(move_t mv, int ply, position_t* pos) {
   char buf[MAX_CHARS_IN_MOVE];
   move_to_str(mv, buf, MAX_CHARS_IN_MOVE);
   printf("info");
+  move_t last_move = pos->last_move;
+  undo_t* x = pos->cold.history;
   int i = 0;
-  while (pos != NULL && i < ply) {
+  while (i < ply) {
     char _buf[MAX_CHARS_IN_MOVE];
-    move_to_str(pos->last_move, _buf, MAX_CHARS_IN_MOVE);
+    move_to_str(last_move, _buf, MAX_CHARS_IN_MOVE);
     printf(" %s", _buf);
-    pos = pos->history;
+    if (x == NULL) {
+      break;
+    }
+    last_move = x->last_move;
+    x = x->history;
     i++;
   }
   printf(" %s %d\n", buf, ply);
@@ -148,22 +150,50 @@ static leafEvalResult evaluate_as_leaf(searchNode* node, searchType_t type) {
   // get transposition table record if available.
   //
   // https://www.chessprogramming.org/Transposition_Table
-  compressedTTRec_t* rec = tt_hashtable_get(node->position.key);
+  compressedTTRec_t* rec = tt_hashtable_get(
+      tt_key(node->position->key, node->position->sym_key));
   if (rec) {
     if (type == SEARCH_SCOUT && tt_is_usable(rec, node->depth, node->beta)) {
       result.type = MOVE_EVALUATED;
       result.score = tt_adjust_score_from_hashtable(rec, node->ply);
       return result;
     }
-    result.hash_table_move = tt_move_of(rec);
+    result.hash_table_move =
+        tt_move_from_table(node->position, tt_move_of(rec));
+  }
+
+  bool quiescence = (node->depth <= 0);  // are we in quiescence?
+  result.should_enter_quiescence = quiescence;
+  bool nmm = type == SEARCH_SCOUT && USE_NMM && node->depth > 0 &&
+             node->depth <= 2;
+  bool futility =
+      type == SEARCH_SCOUT && node->depth <= FUT_DEPTH && node->depth > 0;
+
+  // Only the decisions below look at the static score; elsewhere it is not
+  // worked out at all
+  if (!quiescence && !nmm && !futility) {
+    return result;
+  }
+
+  // margin based forward pruning cuts off at or above this
+  score_t cut = node->beta + (node->depth == 1 ? 3 : 5) * PAWN_VALUE;
+
+  // The static score matters only between lo and hi: below lo and above hi
+  // every decision comes out the same, so eval_lazy() may answer with a bound.
+  score_t lo, hi;
+  if (quiescence) {
+    lo = node->alpha;
+    hi = node->beta;
+  } else {
+    score_t futile = futility ? node->beta - fmarg[node->depth] : cut;
+    lo = futile - 1;
+    hi = nmm ? cut : futile;
   }
 
   // stand pat (having-the-move) bonus
   //
   // https://www.chessprogramming.org/Quiescence_Search#Standing_Pat
-  score_t sps = eval(&(node->position), false) + HMB;
-  bool quiescence = (node->depth <= 0);  // are we in quiescence?
-  result.should_enter_quiescence = quiescence;
+  score_t sps = eval_lazy(node->position, lo - HMB, hi - HMB, LAZY_MARGIN) + HMB;
   if (quiescence) {
     result.score = sps;
     if (result.score >= node->beta) {
@@ -173,25 +203,16 @@ static leafEvalResult evaluate_as_leaf(searchNode* node, searchType_t type) {
   }
 
   // margin based forward pruning
-  if (type == SEARCH_SCOUT && USE_NMM) {
-    if (node->depth <= 2) {
-      if (node->depth == 1 && sps >= node->beta + 3 * PAWN_VALUE) {
-        result.type = MOVE_EVALUATED;
-        result.score = node->beta;
-        return result;
-      }
-      if (node->depth == 2 && sps >= node->beta + 5 * PAWN_VALUE) {
-        result.type = MOVE_EVALUATED;
-        result.score = node->beta;
-        return result;
-      }
-    }
+  if (nmm && sps >= cut) {
+    result.type = MOVE_EVALUATED;
+    result.score = node->beta;
+    return result;
   }
 
   // extended futility pruning
   //
   // https://www.chessprogramming.org/Futility_Pruning#Extended_Futility_Pruning
-  if (type == SEARCH_SCOUT && node->depth <= FUT_DEPTH && node->depth > 0) {
+  if (futility) {
     if (sps + fmarg[node->depth] < node->beta) {
       // treat this ply as a quiescence ply, look only at captures
       result.should_enter_quiescence = true;
@@ -201,29 +222,30 @@ static leafEvalResult evaluate_as_leaf(searchNode* node, searchType_t type) {
   return result;
 }
 
-// Evaluate the move by performing a search.
-static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
-                                         move_t killer_a, move_t killer_b,
-                                         searchType_t type,
-                                         uint64_t* node_count_serial) {
+// Search the position reached by mv, which has already been made on
+// node->position with the given victims.
+static moveEvaluationResult search_made_move(searchNode* node, move_t mv,
+                                             victims_t victims,
+                                             moveEffect_t effect,
+                                             move_t killer_a, move_t killer_b,
+                                             searchType_t type,
+                                             uint64_t* node_count_serial) {
   int ext = 0;           // extensions
   bool blunder = false;  // shoot our own piece
   moveEvaluationResult result;
+  tbassert(node->ply + 1 < MAX_PLY_IN_SEARCH, "Search is too deep\n");
+  result.next_node.subpv = node->subpv + MAX_PLY_IN_SEARCH;
   result.next_node.subpv[0] = NULL_MOVE;
   result.next_node.parent = node;
-
-  // Make the move, and get any victim pieces.
-  // printf("Calling from search_common \n");
-  victims_t victims =
-      make_move(&(node->position), &(result.next_node.position), mv);
+  result.next_node.position = node->position;
 
   // Check whether the game is a game over position - either someone has won or
   // it's in our closing book.
-  if (is_end_game_position(&(result.next_node.position))) {
+  if (is_end_game_position(node->position)) {
     // Compute the end-game score.
     result.type = MOVE_GAMEOVER;
     result.score =
-        get_end_game_score(&(result.next_node.position), node->pov, node->ply);
+        get_end_game_score(node->position, node->pov, node->ply);
     return result;
   }
 
@@ -234,9 +256,9 @@ static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
   }
 
   // Check whether the game results in a draw.
-  if (is_draw(&(result.next_node.position))) {
+  if (is_draw(node->position)) {
     result.type = MOVE_GAMEOVER;
-    result.score = get_draw_score(&(result.next_node.position), node->ply);
+    result.score = get_draw_score(node->position, node->ply);
     return result;
   }
 
@@ -264,7 +286,7 @@ static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
   // https://www.chessprogramming.org/Late_Move_Reductions
   int next_reduction = 0;
   if (type == SEARCH_SCOUT && node->legal_move_count + 1 >= LMR_R1 &&
-      node->depth > 2 && zero_victims(victims) && !move_eq(mv, killer_a) &&
+      node->depth > 2 && effect == EFFECT_QUIET && !move_eq(mv, killer_a) &&
       !move_eq(mv, killer_b)) {
     if (node->legal_move_count + 1 >= LMR_R2) {
       next_reduction = 2;
@@ -318,28 +340,82 @@ static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
   return result;
 }
 
-// Return move with the highest key in the list of moves
-static move_t get_best_move(sortable_move_t* move_list, int num_of_moves) {
-  sortable_move_t* best = NULL;
-  for (int j = 0; j < num_of_moves; j++) {
-    if (!best || move_list[j].key > best->key) {
-      best = move_list + j;
-    } 
+#ifndef NDEBUG
+// Whether predict_move() told the truth about the move that led to p.
+static bool prediction_holds(position_t* p, color_t mover, victims_t victims,
+                             moveEffect_t effect) {
+  if (is_game_over(p)) {
+    return effect == EFFECT_GAME_OVER;
+  }
+  bool own = victims.removed_color[mover];
+  bool enemy = victims.removed_color[opp_color(mover)];
+  switch (effect) {
+    case EFFECT_QUIET:
+      return zero_victims(victims);
+    case EFFECT_ZAP_OWN:
+      return own && !enemy;
+    case EFFECT_SQUASH:
+    case EFFECT_ZAP_ENEMY:
+      return enemy;
+    default:
+      return false;
   }
-  return best->mv;
 }
+#endif
 
-// Insertion sort of the move list. Assumes there is a sentinel at the start of the move_list
-static void sort_insertion(sortable_move_t* move_list, int num_of_moves) {
-  for (int j = 1 ; j < num_of_moves; j ++) {
-    sortable_move_t insert = move_list[j];
-    int hole = j;
-    while (insert.key > move_list[hole - 1].key) {
-      move_list[hole] = move_list[hole-1];
-      hole--;
-    }
-    move_list[hole] = insert;
+// Evaluate the move by performing a search.  The move is made on
+// node->position in place and taken back before returning.  pred is the
+// move's prediction if the move picker made one, or NULL.
+static moveEvaluationResult evaluateMove(searchNode* node, move_t mv,
+                                         const movePrediction_t* pred,
+                                         move_t killer_a, move_t killer_b,
+                                         searchType_t type,
+                                         uint64_t* node_count_serial) {
+  undo_t undo;
+  movePrediction_t own_pred;
+  if (pred == NULL) {
+    predict_move(node->position, mv, &own_pred);
+    pred = &own_pred;
+  }
+  moveEffect_t effect = (moveEffect_t)pred->effect;
+
+  // Noncaptures and blunders are ignored in quiescence, so there is no need
+  // to make them.
+  if (node->quiescence &&
+      (effect == EFFECT_QUIET || effect == EFFECT_ZAP_OWN)) {
+    moveEvaluationResult result;
+    result.type = MOVE_IGNORE;
+    return result;
   }
+
+  // The child's transposition table set and eval cache entry load while the
+  // move is made.  Many moves that get this far zap a Monarch, and the game
+  // over they lead to is scored without looking at either, so nothing is
+  // loaded for them.
+  uint64_t child_key = 0;
+  uint64_t child_sym_key = 0;
+  if (effect != EFFECT_GAME_OVER) {
+    child_key = key_after(node->position, mv, pred, &child_sym_key);
+    tt_prefetch(tt_key(child_key, child_sym_key));
+    eval_cache_prefetch(child_key);
+  }
+
+  // Make the move, and get any victim pieces.
+  victims_t victims = make_move(node->position, mv, &undo);
+  tbassert(effect == EFFECT_GAME_OVER || node->position->key == child_key,
+           "key_after: %" PRIu64 ", key: %" PRIu64 "\n", child_key,
+           node->position->key);
+  tbassert(effect == EFFECT_GAME_OVER ||
+               node->position->sym_key == child_sym_key,
+           "key_after: %" PRIu64 ", sym_key: %" PRIu64 "\n", child_sym_key,
+           node->position->sym_key);
+  tbassert(prediction_holds(node->position, opp_color(color_to_move_of(node->position)),
+                            victims, effect),
+           "predict_move() got the move wrong (effect %d)\n", effect);
+  moveEvaluationResult result = search_made_move(
+      node, mv, victims, effect, killer_a, killer_b, type, node_count_serial);
+  unmake_move(node->position, &undo);
+  return result;
 }
 
 // Returns true if a cutoff was triggered, false otherwise.
@@ -351,10 +427,15 @@ static bool search_process_score(searchNode* node, move_t mv, int mv_index,
     node->best_move_index = mv_index;
     node->subpv[0] = mv;
 
-    // write best move into right position in PV buffer.
-    memcpy(node->subpv + 1, result->next_node.subpv,
-           sizeof(move_t) * (MAX_PLY_IN_SEARCH - 1));
-    node->subpv[MAX_PLY_IN_SEARCH - 1] = NULL_MOVE;
+    // write best move into right position in PV buffer, followed by the
+    // child's line up to its terminating NULL_MOVE.
+    const move_t* line = result->next_node.subpv;
+    int i = 0;
+    while (i < MAX_PLY_IN_SEARCH - 2 && line[i] != NULL_MOVE) {
+      node->subpv[i + 1] = line[i];
+      i++;
+    }
+    node->subpv[i + 1] = NULL_MOVE;
 
     if (type != SEARCH_SCOUT && result->score > node->alpha) {
       node->alpha = result->score;
@@ -383,71 +464,140 @@ static bool should_abort_check() {
   return false;
 }
 
-// Obtain a sorted move list.
+// Staged move picker (see movePicker in search.h).
 //
 // https://www.chessprogramming.org/Move_Ordering
 
-static int get_sortable_move_list(searchNode* node, sortable_move_t* move_list, move_t hash_table_move) {
-  // number of moves in list
-  int num_of_moves = generate_all(&(node->position), move_list);
-
-  color_t fake_color_to_move = color_to_move_of(&(node->position));
+static void init_move_picker(movePicker* mp, searchNode* node,
+                             move_t hash_table_move, bool partial) {
+  mp->position = node->position;
+  mp->stage = PICK_HASH;
+  mp->hash_move = hash_table_move;
+  mp->killer_a = node->killer[KMT(node->ply, 0)];
+  mp->killer_b = node->killer[KMT(node->ply, 1)];
+  mp->quiescence = node->quiescence;
+  mp->partial = partial;
+  mp->best_move_history = node->best_move_history;
+}
 
-  move_t killer_a = node->killer[KMT(node->ply, 0)];
-  move_t killer_b = node->killer[KMT(node->ply, 1)];
+static sort_key_t history_key_of(movePicker* mp, color_t color, move_t mv) {
+  int ot = (ori_of(piece_at(mp->position, from_square(mv))) + rot_of(mv)) % NUM_ORI;
+  int key = mp->best_move_history[BMH(color, ptype_mv_of(mv), to_square(mv), ot)];
+  if (mp->partial && key < 5) {
+    key = 0;
+  }
+  return key;
+}
 
-  // sort special moves to the front
-  for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
-    move_t mv = get_move(move_list[mv_index]);
-    if (move_eq(mv, hash_table_move)) {
-      move_list[mv_index].key = MAX_SORT_KEY;
-    } else if (move_eq(mv, killer_a)) {
-      move_list[mv_index].key = MAX_SORT_KEY - 1;
-    } else if (move_eq(mv, killer_b)) {
-      move_list[mv_index].key = MAX_SORT_KEY - 2;
+// Generates and predicts every move not already handed out, split into the
+// moves that zap the enemy, followed by the rest.
+static void generate_picker_moves(movePicker* mp) {
+  position_t* p = mp->position;
+  color_t color = color_to_move_of(p);
+  sortable_move_t quiet[MAX_NUM_MOVES];
+  movePrediction_t quiet_preds[MAX_NUM_MOVES];
+  int num_quiet = 0;
+  int num_zapping = 0;
+
+  int num_moves = generate_all(p, mp->moves);
+  for (int i = 0; i < num_moves; i++) {
+    move_t mv = get_move(mp->moves[i]);
+    if (move_eq(mv, mp->hash_move) || move_eq(mv, mp->killer_a) ||
+        move_eq(mv, mp->killer_b)) {
+      continue;  // already handed out
+    }
+    sortable_move_t smv = mp->moves[i];
+    smv.key = history_key_of(mp, color, mv);
+
+    movePrediction_t pred;
+    predict_move(p, mv, &pred);
+    if (pred.effect != EFFECT_QUIET && pred.effect != EFFECT_ZAP_OWN) {
+      mp->preds[num_zapping] = pred;
+      mp->moves[num_zapping++] = smv;
     } else {
-      ptype_t pce = mv.typ;
-      rot_t ro = mv.rot;
-      square_t fs = mv.from_sq;
-      square_t ts = mv.to_sq;
-      int ot = (ori_of(node->position.board[fs]) + ro) % NUM_ORI;
-      move_list[mv_index].key = node->best_move_history[BMH(fake_color_to_move, pce, ts, ot)];
+      quiet_preds[num_quiet] = pred;
+      quiet[num_quiet++] = smv;
     }
   }
-  return num_of_moves;
+  memcpy(mp->moves + num_zapping, quiet, sizeof(sortable_move_t) * num_quiet);
+  memcpy(mp->preds + num_zapping, quiet_preds,
+         sizeof(movePrediction_t) * num_quiet);
+  mp->num_zapping = num_zapping;
+  mp->num_moves = num_zapping + num_quiet;
+  mp->next = 0;
 }
 
-static int get_sortable_move_list_partial(searchNode* node, sortable_move_t* move_list, move_t hash_table_move) {
-  // number of moves in list
-    int num_of_moves = generate_all(&(node->position), move_list);
-
-  color_t fake_color_to_move = color_to_move_of(&(node->position));
-
-  move_t killer_a = node->killer[KMT(node->ply, 0)];
-  move_t killer_b = node->killer[KMT(node->ply, 1)];
-
-  // sort special moves to the front
-  for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
-    move_t mv = get_move(move_list[mv_index]);
-    if (move_eq(mv, hash_table_move)) {
-      move_list[mv_index].key = MAX_SORT_KEY;
-    } else if (move_eq(mv, killer_a)) {
-      move_list[mv_index].key = MAX_SORT_KEY - 1;
-    } else if (move_eq(mv, killer_b)) {
-      move_list[mv_index].key = MAX_SORT_KEY - 2;
-    } else {
-      ptype_t pce = mv.typ;
-      rot_t ro = mv.rot;
-      square_t fs = mv.from_sq;
-      square_t ts = mv.to_sq;
-      int ot = (ori_of(node->position.board[fs]) + ro) % NUM_ORI;
-      int key = node->best_move_history[BMH(fake_color_to_move, pce, ts, ot)];
-      if (key < 5) {
-        key = 0;
-      }
-      move_list[mv_index].key = key;
+// Returns the move with the highest key in moves[next .. end), keeping the
+// remaining moves in order, and its prediction in *pred.
+static move_t pick_best(movePicker* mp, int end,
+                        const movePrediction_t** pred) {
+  int best = mp->next;
+  for (int j = mp->next + 1; j < end; j++) {
+    if (mp->moves[j].key > mp->moves[best].key) {
+      best = j;
     }
   }
-  return num_of_moves;
+  sortable_move_t picked = mp->moves[best];
+  movePrediction_t picked_pred = mp->preds[best];
+  for (int j = best; j > mp->next; j--) {
+    mp->moves[j] = mp->moves[j - 1];
+    mp->preds[j] = mp->preds[j - 1];
+  }
+  mp->moves[mp->next] = picked;
+  mp->preds[mp->next] = picked_pred;
+  *pred = &mp->preds[mp->next++];
+  return picked.mv;
 }
 
+// Returns the next move to search, or NULL_MOVE once the moves run out.
+// *pred receives the move's prediction, which stays valid until the next
+// call, or NULL for the hash move and the killers, which are not predicted
+// here.
+static move_t next_move(movePicker* mp, const movePrediction_t** pred) {
+  *pred = NULL;
+  switch (mp->stage) {
+    case PICK_HASH:
+      mp->stage = PICK_KILLER_A;
+      if (is_pseudo_legal(mp->position, mp->hash_move)) {
+        return mp->hash_move;
+      }
+      // fall through
+    case PICK_KILLER_A:
+      mp->stage = PICK_KILLER_B;
+      if (!move_eq(mp->killer_a, mp->hash_move) &&
+          is_pseudo_legal(mp->position, mp->killer_a)) {
+        return mp->killer_a;
+      }
+      // fall through
+    case PICK_KILLER_B:
+      mp->stage = PICK_GENERATE;
+      if (!move_eq(mp->killer_b, mp->hash_move) &&
+          !move_eq(mp->killer_b, mp->killer_a) &&
+          is_pseudo_legal(mp->position, mp->killer_b)) {
+        return mp->killer_b;
+      }
+      // fall through
+    case PICK_GENERATE:
+      generate_picker_moves(mp);
+      mp->stage = PICK_ZAPPING;
+      // fall through
+    case PICK_ZAPPING:
+      if (mp->next < mp->num_zapping) {
+        return pick_best(mp, mp->num_zapping, pred);
+      }
+      if (mp->quiescence) {
+        mp->stage = PICK_DONE;
+        return NULL_MOVE;
+      }
+      mp->stage = PICK_QUIET;
+      // fall through
+    case PICK_QUIET:
+      if (mp->next < mp->num_moves) {
+        return pick_best(mp, mp->num_moves, pred);
+      }
+      mp->stage = PICK_DONE;
+      // fall through
+    default:
+      return NULL_MOVE;
+  }
+}
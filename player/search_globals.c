@@ -30,23 +30,23 @@ static move_t killer __KMT_dim__;  // up to 4 killers
 
 const uint64_t entry_mask = MBS_SET-1;
 
-volatile uint64_t moves_being_searched[MBS_SET][MBS_WAY];
+// Each way holds a packed move, so a whole set fits in one 8-byte word.  An
+// empty way holds NULL_MOVE.
+volatile move_t moves_being_searched[MBS_SET][MBS_WAY];
 
 static void finish_search(uint64_t pos_hash, move_t mv) {
-  uint32_t move_hash = *(uint32_t*) (&mv);
-  uint64_t index = (pos_hash ^ move_hash) & entry_mask;
+  uint64_t index = (pos_hash ^ mv) & entry_mask;
   for (int i = 0; i < MBS_WAY; i++) {
-    if (moves_being_searched[index][i] == move_hash) {
-      moves_being_searched[index][i] =0;
+    if (moves_being_searched[index][i] == mv) {
+      moves_being_searched[index][i] = NULL_MOVE;
     }
   }
 }
 
 static bool is_move_searching(uint64_t pos_hash, move_t mv) {
-  uint32_t move_hash = *(uint32_t*) (&mv);
-  uint64_t index = (pos_hash ^ move_hash) & entry_mask;
+  uint64_t index = (pos_hash ^ mv) & entry_mask;
   for (int i = 0; i< MBS_WAY; i ++) {
-    if (moves_being_searched[index][i] == move_hash) {
+    if (moves_being_searched[index][i] == mv) {
       return true;
     }
   }
@@ -54,15 +54,14 @@ static bool is_move_searching(uint64_t pos_hash, move_t mv) {
 }
 
 static void set_search_move(uint64_t pos_hash, move_t mv) {
-  uint32_t move_hash = *(uint32_t*) (&mv);
-  uint64_t index = (pos_hash ^ move_hash) & entry_mask;
+  uint64_t index = (pos_hash ^ mv) & entry_mask;
   for (int i = 0; i < MBS_WAY; i ++) {
-    if (moves_being_searched[index][i] == 0){
-      moves_being_searched[index][i] = move_hash;
+    if (moves_being_searched[index][i] == NULL_MOVE) {
+      moves_being_searched[index][i] = mv;
       return;
     }
   }
-  moves_being_searched[index][0] = move_hash;
+  moves_being_searched[index][0] = mv;
 }
 
 static void update_best_move_history(position_t* p, int index_of_best,
@@ -73,11 +72,11 @@ static void update_best_move_history(position_t* p, int index_of_best,
 
   for (int i = 0; i < count; i++) {
     move_t mv = get_move(lst[i]);
-    ptype_t pce = mv.typ;
-    rot_t ro = mv.rot;
-    square_t fs = mv.from_sq;
-    square_t ts = mv.to_sq;
-    int ot = (ori_of(p->board[fs]) + ro) % NUM_ORI;
+    ptype_t pce = ptype_mv_of(mv);
+    rot_t ro = rot_of(mv);
+    square_t fs = from_square(mv);
+    square_t ts = to_square(mv);
+    int ot = (ori_of(piece_at(p, fs)) + ro) % NUM_ORI;
 
     int s = best_move_history[BMH(color_to_move, pce, ts, ot)];
 
@@ -93,34 +92,35 @@ static void update_best_move_history(position_t* p, int index_of_best,
 }
 
 static void update_transposition_table(searchNode* node) {
+  uint64_t key = tt_key(node->position->key, node->position->sym_key);
   if (node->type == SEARCH_SCOUT) {
     if (node->best_score < node->beta) {
       tt_hashtable_put(
-          node->position.key, node->depth,
+          key, node->depth,
           tt_adjust_score_for_hashtable(node->best_score, node->ply), (uint8_t) UPPER,
           NULL_MOVE);
     } else {
       tt_hashtable_put(
-          node->position.key, node->depth,
+          key, node->depth,
           tt_adjust_score_for_hashtable(node->best_score, node->ply), (uint8_t) LOWER,
-          node->subpv[0]);
+          tt_move_to_table(node->position, node->subpv[0]));
     }
   } else if (node->type == SEARCH_PV) {
     if (node->best_score <= node->orig_alpha) {
       tt_hashtable_put(
-          node->position.key, node->depth,
+          key, node->depth,
           tt_adjust_score_for_hashtable(node->best_score, node->ply), (uint8_t) UPPER,
           NULL_MOVE);
     } else if (node->best_score >= node->beta) {
       tt_hashtable_put(
-          node->position.key, node->depth,
+          key, node->depth,
           tt_adjust_score_for_hashtable(node->best_score, node->ply), (uint8_t) LOWER,
-          node->subpv[0]);
+          tt_move_to_table(node->position, node->subpv[0]));
     } else {
       tt_hashtable_put(
-          node->position.key, node->depth,
+          key, node->depth,
           tt_adjust_score_for_hashtable(node->best_score, node->ply), (uint8_t) EXACT,
-          node->subpv[0]);
+          tt_move_to_table(node->position, node->subpv[0]));
     }
   }
 }
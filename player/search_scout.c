@@ -39,7 +39,7 @@ static void initialize_scout_node(searchNode* node, int depth) {
   node->ply = node->parent->ply + 1;
   node->subpv[0] = NULL_MOVE;
   node->legal_move_count = 0;
-  node->fake_color_to_move = color_to_move_of(&(node->position));
+  node->fake_color_to_move = color_to_move_of(node->position);
   // point of view = 1 for white, -1 for black
   node->pov = 1 - node->fake_color_to_move * 2;
   node->best_move_index = 0;  // index of best move found
@@ -48,14 +48,14 @@ static void initialize_scout_node(searchNode* node, int depth) {
   node->best_move_history = node->parent->best_move_history;
 }
 
-bool process_move(move_t mv, int index, searchNode* node, move_t killer_a, move_t killer_b, uint64_t* node_count_serial) {
+bool process_move(move_t mv, const movePrediction_t* pred, int index, searchNode* node, move_t killer_a, move_t killer_b, uint64_t* node_count_serial) {
   if (TRACE_MOVES) {
-    print_move_info(mv, node->ply, &node->position);
+    print_move_info(mv, node->ply, node->position);
   }
   // printf("Calling from process_move \n");
-  moveEvaluationResult result = evaluateMove(node, mv, killer_a, killer_b, SEARCH_SCOUT, node_count_serial);
+  moveEvaluationResult result = evaluateMove(node, mv, pred, killer_a, killer_b, SEARCH_SCOUT, node_count_serial);
 
-  finish_search(node->position.key, mv) ;
+  finish_search(node->position->key, mv) ;
 
   if (result.type == MOVE_ILLEGAL || result.type == MOVE_IGNORE || abortf || parallel_parent_aborted(node)) {
     return false;
@@ -105,15 +105,10 @@ static score_t scout_search(searchNode* node, int depth,
   move_t killer_a = node->killer[KMT(node->ply, 0)];
   move_t killer_b = node->killer[KMT(node->ply, 1)];
 
-  // Store the sorted move list on the stack.
-  //   MAX_NUM_MOVES is all that we need.
-  sortable_move_t move_list_with_sentinel[MAX_NUM_MOVES];
-  move_list_with_sentinel[0].key = MAX_SORT_KEY;
-  sortable_move_t* move_list = move_list_with_sentinel + 1;
-
-
-  // Obtain the sorted move list.
-  int num_of_moves = get_sortable_move_list_partial(node, move_list, hash_table_move);
+  // Hand out moves lazily: a node that cuts off on the hash move or a killer
+  //   never generates its moves at all.
+  movePicker picker;
+  init_move_picker(&picker, node, hash_table_move, true);
   int number_of_moves_evaluated = 0;
 
   // A simple mutex. See simple_mutex.h for implementation details.
@@ -121,45 +116,32 @@ static score_t scout_search(searchNode* node, int depth,
   init_simple_mutex(&node_mutex);
 
   sortable_move_t tried[MAX_NUM_MOVES];
+  sortable_move_t deferred[MAX_NUM_MOVES];
+  int deferred_count = 0;
+  bool isFirst = true;
+  bool cutoff = false;
+
+  for (int abd_pass = 0; abd_pass < 2 && !cutoff; abd_pass++) {
+    for (int mv_index = 0;; mv_index++) {
+      const movePrediction_t* pred = NULL;  // none for deferred moves
+      move_t mv = (abd_pass == 0) ? next_move(&picker, &pred)
+                  : (mv_index < deferred_count) ? deferred[mv_index].mv
+                                                : NULL_MOVE;
+      if (move_eq(mv, NULL_MOVE)) {
+        break;
+      }
+      if (abd_pass == 0 && is_move_searching(node->position->key, mv) && !isFirst) {
+        deferred[deferred_count++].mv =mv;
+        isFirst = false;
+        continue;
+      }
+      tried[number_of_moves_evaluated].mv = mv;
+      set_search_move(node->position->key, mv);
+      isFirst = false;
 
-  if (num_of_moves > 0) {
-    move_t best_move = get_best_move(move_list, num_of_moves);
-    tried[number_of_moves_evaluated].mv = best_move;
-    // printf("Calling from scout_search after finding best_move \n");
-    bool cutoff = process_move(best_move, number_of_moves_evaluated, node, killer_a, killer_b, node_count_serial);
-    number_of_moves_evaluated++;
-
-    if (!cutoff) { // Have to evaluate more than one move
-      //Sort the move list
-      sort_insertion(move_list_with_sentinel, num_of_moves + 1);
-
-      tbassert(move_eq(best_move, move_list[0].mv), "Best move is not at the front of the move_list");
-
-      sortable_move_t deferred[MAX_NUM_MOVES];
-      int deferred_count = 0;
-      bool isFirst = true;
-      sortable_move_t* moves_to_scan = move_list + 1;
-
-      for (int abd_pass = 0; abd_pass <2; abd_pass++) {
-        int move_count = (abd_pass == 0) ? num_of_moves - 1 : deferred_count;
-        for (int mv_index = 0; mv_index < move_count; mv_index++) {
-          move_t mv = get_move(moves_to_scan[mv_index]);
-          if (abd_pass == 0 && is_move_searching(node->position.key, mv) && !isFirst) {
-            deferred[deferred_count++].mv =mv;
-            isFirst = false;
-            continue;
-          }
-          tried[number_of_moves_evaluated].mv = mv;
-          set_search_move(node->position.key, mv);
-          isFirst = false;
-
-          bool cutoff = process_move(mv, number_of_moves_evaluated++, node, killer_a, killer_b, node_count_serial);
-          if (cutoff) {
-            mv_index ++;
-            break;
-          }
-        }
-        moves_to_scan = deferred;
+      cutoff = process_move(mv, pred, number_of_moves_evaluated++, node, killer_a, killer_b, node_count_serial);
+      if (cutoff) {
+        break;
       }
     }
   }
@@ -171,13 +153,13 @@ static score_t scout_search(searchNode* node, int depth,
   }
 
   if (node->quiescence == false) {
-    update_best_move_history(&(node->position), node->best_move_index,
+    update_best_move_history(node->position, node->best_move_index,
                               tried, number_of_moves_evaluated, node->best_move_history);
   }
 
   tbassert(abs(node->best_score) != -INF, "best_score = %d\n",
            node->best_score);
-  // Reads node->position.key, node->depth, node->best_score, and node->ply
+  // Reads node->position->key, node->depth, node->best_score, and node->ply
   update_transposition_table(node);
   return node->best_score;
 }
@@ -14,6 +14,7 @@
 int HASH;    // hash table size in MBytes
 int USE_TT;  // Use the transposition table.
 // Turn off for deterministic behavior of the search.
+int USE_SYMMETRY;  // Store a position and its symmetric image as one entry.
 
 #define NUM_LOCK 6
 simple_mutex_t tt_lock[NUM_LOCK];
@@ -24,31 +25,23 @@ uint64_t simple_mutex_mask = NUM_LOCK-1;
 struct compressedTTRec {
   uint64_t key;
   uint64_t data;
-  //Data include: 10 extra zeros | 8 bits for age | 2 bits for bound | 8 bits for quality | 16 bits for score | 20 bits for move_t
-  //move_t break down: 6 bits for to_sq | 6 bits for from_sq | 2 bits for ori | 2 bits for ptype_t
+  //Data include: 14 extra zeros | 8 bits for age | 2 bits for bound | 8 bits for quality | 16 bits for score | 16 bits for move_t
+  //move_t is stored in its packed 16-bit form, see move_gen.h
 };
 //move_t compressed
 const uint64_t MOVE_SHIFT = 0;
-const uint64_t MOVE_MASK = (((uint64_t) 0b11111111111111111111) << MOVE_SHIFT);
-const uint64_t PTYPE_MOVE_SHIFT = 0;
-const uint64_t PTYPE_MOVE_MASK = (((uint64_t) 0b11) << PTYPE_MOVE_SHIFT);
-const uint64_t ORI_MOVE_SHIFT = 2;
-const uint64_t ORI_MOVE_MASK = (((uint64_t) 0b11) << ORI_MOVE_SHIFT);
-const uint64_t FROM_SQ_SHIFT = 4;
-const uint64_t FROM_SQ_MASK = (((uint64_t) 0b11111111) << FROM_SQ_SHIFT);
-const uint64_t TO_SQ_SHIFT = 12;
-const uint64_t TO_SQ_MASK = (((uint64_t) 0b11111111) << TO_SQ_SHIFT);
+const uint64_t MOVE_MASK = (((uint64_t) 0b1111111111111111) << MOVE_SHIFT);
 //score compressed
-const uint64_t SCORE_SHIFT = 20;
+const uint64_t SCORE_SHIFT = 16;
 const uint64_t SCORE_MASK = (((uint64_t) 0b1111111111111111) << SCORE_SHIFT);
 //quality compressed
-const uint64_t QUALITY_SHIFT = 36;
+const uint64_t QUALITY_SHIFT = 32;
 const uint64_t QUALITY_MASK = (((uint64_t) 0b11111111) << QUALITY_SHIFT);
 //bound compressed
-const uint64_t BOUND_SHIFT = 44;
+const uint64_t BOUND_SHIFT = 40;
 const uint64_t BOUND_MASK = (((uint64_t) 0b11) << BOUND_SHIFT);
 //age compressed
-const uint64_t AGE_SHIFT = 46;
+const uint64_t AGE_SHIFT = 42;
 const uint64_t AGE_MASK = (((uint64_t) 0b11111111) << AGE_SHIFT);
 
 // -----------------------------------------------------------------------------
@@ -73,16 +66,7 @@ score_t static inline __attribute__((always_inline)) get_score_compressed(compre
 }
 
 move_t static inline __attribute__((always_inline)) get_move_compressed(compressedTTRec_t* tt) {
-  move_t move;
-  uint64_t data_compressed = tt->data;
-  //Get ptype
-  uint8_t ptype =  (data_compressed & PTYPE_MOVE_MASK) >> PTYPE_MOVE_SHIFT;
-  move.typ = (ptype_t) ptype;
-  uint8_t rot = (data_compressed & ORI_MOVE_MASK) >> ORI_MOVE_SHIFT;
-  move.rot = (rot_t) rot;
-  move.from_sq = (data_compressed & FROM_SQ_MASK) >> FROM_SQ_SHIFT;
-  move.to_sq = (data_compressed & TO_SQ_MASK) >> TO_SQ_SHIFT;
-  return move;
+  return (move_t) ((tt->data & MOVE_MASK) >> MOVE_SHIFT);
 }
 
 // -----------------------------------------------------------------------------
@@ -132,21 +116,11 @@ void static inline __attribute__((always_inline)) set_score_compressed (compress
 
 void static inline __attribute__((always_inline)) set_move_compressed (compressedTTRec_t* tt, move_t move) {
   uint64_t data = tt->data;
-  uint64_t new_move = 0;
-  uint64_t ptype = (uint64_t) (move.typ);
-  uint64_t rot = (uint64_t) (move.rot);
-  uint64_t from_sq = (uint64_t) move.from_sq;
-  uint64_t to_sq = (uint64_t) move.to_sq; 
-
-  new_move |= ptype << PTYPE_MOVE_SHIFT;
-  new_move |= rot << ORI_MOVE_SHIFT;
-  new_move |= from_sq << FROM_SQ_SHIFT;
-  new_move |= to_sq << TO_SQ_SHIFT;
-
-  data &= ~MOVE_MASK; 
-  data |= (new_move) << MOVE_SHIFT;
+  uint64_t new_move = (uint64_t) move;
+  data &= ~MOVE_MASK;
+  data |= (new_move << MOVE_SHIFT);
   tt->data = data;
-  tbassert(move_eq(get_move_compressed(tt), move), "Move was not set correctly!"); 
+  tbassert(move_eq(get_move_compressed(tt), move), "Move was not set correctly!");
 }
 
 // each set is a RECORDE_PER_SET-way set-associative cache of records
@@ -291,6 +265,56 @@ compressedTTRec_t* tt_hashtable_get(uint64_t key) {
   return found;
 }
 
+// Starts loading the set that tt_hashtable_get(key) will look at, so that a
+// later probe does not have to wait for memory.
+__attribute__((always_inline)) void tt_prefetch(uint64_t key) {
+  __builtin_prefetch(&hashtable.tt_set[key & hashtable.mask]);
+}
+
+// A position and its symmetric image (see sym_square()) are worth the same to
+// the side to move, and the best move of one is the sym_move() of the other's.
+// With USE_SYMMETRY both are stored under the smaller of their two keys, with
+// the move as played in the position that owns that key.
+__attribute__((always_inline)) uint64_t tt_key(uint64_t key, uint64_t sym_key) {
+  return (USE_SYMMETRY && sym_key < key) ? sym_key : key;
+}
+
+static inline bool stored_as_image(position_t* p) {
+  return USE_SYMMETRY && p->sym_key < p->key;
+}
+
+// A Monarch firing without moving.  It is always written with the first
+// Monarch of the side to move, which sym_move() turns into the last one.
+static inline bool is_null_move(move_t mv) {
+  return mv != NULL_MOVE && from_square(mv) == to_square(mv) &&
+         rot_of(mv) == NONE;
+}
+
+// The move to store in p's entry for mv, a move in p.
+move_t tt_move_to_table(position_t* p, move_t mv) {
+  if (!stored_as_image(p)) {
+    return mv;
+  }
+  if (is_null_move(mv)) {
+    uint64_t monarchs = monarchs_of(p, color_to_move_of(p));
+    square_t sq = sym_square(BOARD_SIZE - 1 - __builtin_clzll(monarchs));
+    return move_of(MONARCH, NONE, sq, sq);
+  }
+  return sym_move(mv);
+}
+
+// The move in p for mv, a move read from p's entry.
+move_t tt_move_from_table(position_t* p, move_t mv) {
+  if (!stored_as_image(p)) {
+    return mv;
+  }
+  if (is_null_move(mv)) {
+    square_t sq = __builtin_ctzll(monarchs_of(p, color_to_move_of(p)));
+    return move_of(MONARCH, NONE, sq, sq);
+  }
+  return sym_move(mv);
+}
+
 score_t win_in(int ply) { return WIN - ply; }
 
 score_t lose_in(int ply) { return -WIN + ply; }
@@ -37,6 +37,10 @@ void tt_age_hashtable();
 void tt_hashtable_put(uint64_t key, uint8_t depth, score_t score, uint8_t type,
                       move_t move);
 compressedTTRec_t* tt_hashtable_get(uint64_t key);
+__attribute__((always_inline)) void tt_prefetch(uint64_t key);
+__attribute__((always_inline)) uint64_t tt_key(uint64_t key, uint64_t sym_key);
+move_t tt_move_to_table(position_t* p, move_t mv);
+move_t tt_move_from_table(position_t* p, move_t mv);
 
 score_t tt_adjust_score_from_hashtable(compressedTTRec_t* rec, int ply);
 score_t tt_adjust_score_for_hashtable(score_t score, int ply);
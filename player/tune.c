@@ -0,0 +1,267 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+#include "tune.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PARALLEL
+#include <cilk/cilk.h>
+#endif
+
+#include "dataset.h"
+#include "eval.h"
+#include "move_gen.h"
+
+// Each position is featurized once, with eval_features(), so the fit sees
+// exactly the terms the search evaluates.  Its score for White is then linear
+// in the weights,
+//   s = sum over i of x[i] * w[i],   x[i] = eval_features()[i] * scale[i],
+// and the weights minimize the logistic loss
+//   -y log(q) - (1 - y) log(1 - q),   q = sigmoid(s / K),
+// of the outcome y (1 White won, 1/2 drawn, 0 Black won), averaged over the
+// positions.  K, centipawns per unit of the logit, is fit first to the
+// starting weights and then held, and PMAT's weight stays at one Pawn, which
+// keeps the other weights in Pawns.  The weights move by full-batch gradient
+// descent with Adam steps.
+
+#define DEFAULT_ITERATIONS 1000
+
+// Positions per piece of the loss and gradient, summed in parallel
+#define CHUNK 16384
+
+// The range setoption accepts for the weights (DEFAULT_MIN and DEFAULT_MAX in
+// options.h)
+#define MAX_WEIGHT (5 * PAWN_EV_VALUE)
+
+// Adam: step size in units of a weight, decayed linearly to 0, and the decay
+// rates of the moment estimates
+#define LEARNING_RATE (0.01 * PAWN_EV_VALUE)
+#define BETA1 0.9
+#define BETA2 0.999
+
+typedef struct {
+  float* x;  // n rows of NUM_HEURISTICS
+  float* y;
+  size_t n;
+} tuneData_t;
+
+// Featurizes record i into row i, or leaves y[i] at -1 if it holds no board
+static void featurize(const dataRecord_t* records, size_t i, tuneData_t* d) {
+  position_t p;
+  d->y[i] = -1;
+  if (record_to_pos(&records[i], &p) != 0) {
+    return;
+  }
+  int32_t features[NUM_HEURISTICS];
+  eval_features(&p, features);
+  for (int j = 0; j < NUM_HEURISTICS; j++) {
+    d->x[i * NUM_HEURISTICS + j] = features[j] * eval_feature_scale(j);
+  }
+  d->y[i] = records[i].result / 2.0f;
+}
+
+// Loss and, if grad is not NULL, its gradient for the positions of chunk c,
+// summed rather than averaged
+static double chunk_loss(const tuneData_t* d, size_t c, const double* w,
+                         double k, double* grad) {
+  size_t end = (c + 1) * CHUNK < d->n ? (c + 1) * CHUNK : d->n;
+  double loss = 0;
+  for (size_t i = c * CHUNK; i < end; i++) {
+    const float* x = &d->x[i * NUM_HEURISTICS];
+    double s = 0;
+    for (int j = 0; j < NUM_HEURISTICS; j++) {
+      s += x[j] * w[j];
+    }
+    double z = s / k;
+    // -y log(sigmoid(z)) - (1 - y) log(1 - sigmoid(z)), without overflow
+    loss += fmax(z, 0) - z * d->y[i] + log1p(exp(-fabs(z)));
+    if (grad != NULL) {
+      double err = 1 / (1 + exp(-z)) - d->y[i];
+      for (int j = 0; j < NUM_HEURISTICS; j++) {
+        grad[j] += err * x[j] / k;
+      }
+    }
+  }
+  return loss;
+}
+
+// Mean loss over all positions, and its gradient if grad is not NULL
+static double loss(const tuneData_t* d, const double* w, double k,
+                   double* grad) {
+  size_t chunks = (d->n + CHUNK - 1) / CHUNK;
+  double* part = calloc(chunks * (NUM_HEURISTICS + 1), sizeof(double));
+  #ifdef PARALLEL
+    cilk_for (size_t c = 0; c < chunks; c++) {
+      double* r = &part[c * (NUM_HEURISTICS + 1)];
+      r[NUM_HEURISTICS] = chunk_loss(d, c, w, k, grad ? r : NULL);
+    }
+  #else
+    for (size_t c = 0; c < chunks; c++) {
+      double* r = &part[c * (NUM_HEURISTICS + 1)];
+      r[NUM_HEURISTICS] = chunk_loss(d, c, w, k, grad ? r : NULL);
+    }
+  #endif
+
+  // summed in chunk order, so the result does not depend on the schedule
+  double total = 0;
+  if (grad != NULL) {
+    memset(grad, 0, NUM_HEURISTICS * sizeof(double));
+  }
+  for (size_t c = 0; c < chunks; c++) {
+    double* r = &part[c * (NUM_HEURISTICS + 1)];
+    total += r[NUM_HEURISTICS];
+    for (int j = 0; grad != NULL && j < NUM_HEURISTICS; j++) {
+      grad[j] += r[j] / d->n;
+    }
+  }
+  free(part);
+  return total / d->n;
+}
+
+// K minimizing the loss of the weights w, by golden-section search
+static double fit_k(const tuneData_t* d, const double* w) {
+  const double phi = (sqrt(5) - 1) / 2;
+  double lo = 10;
+  double hi = 20 * PAWN_VALUE;
+  double a = hi - phi * (hi - lo);
+  double b = lo + phi * (hi - lo);
+  double la = loss(d, w, a, NULL);
+  double lb = loss(d, w, b, NULL);
+  while (hi - lo > 0.5) {
+    if (la < lb) {
+      hi = b;
+      b = a;
+      lb = la;
+      a = hi - phi * (hi - lo);
+      la = loss(d, w, a, NULL);
+    } else {
+      lo = a;
+      a = b;
+      la = lb;
+      b = lo + phi * (hi - lo);
+      lb = loss(d, w, b, NULL);
+    }
+  }
+  return (lo + hi) / 2;
+}
+
+static void print_weights(const int* w) {
+  for (int j = 0; j < NUM_HEURISTICS; j++) {
+    if (j == PMAT) {
+      continue;
+    }
+    char name[16];
+    size_t len = strlen(heuristic_strs[j]);
+    for (size_t c = 0; c <= len; c++) {
+      name[c] = tolower(heuristic_strs[j][c]);
+    }
+    printf("    {\"%s\", &%s_weight, (int)(%.4f * P_EV_VAL), DEFAULT_MIN,\n"
+           "     DEFAULT_MAX},\n",
+           name, heuristic_strs[j], (double)w[j] / PAWN_EV_VALUE);
+  }
+}
+
+int tune_main(int argc, char* argv[]) {
+  if (argc < 1 || argc > 2) {
+    fprintf(stderr, "Usage: leiserchess tune <dataset> [iterations]\n");
+    return 1;
+  }
+  int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+
+  size_t num_records;
+  dataRecord_t* records = dataset_read(argv[0], &num_records);
+  if (records == NULL) {
+    return 1;
+  }
+
+  tuneData_t d;
+  d.x = malloc(num_records * NUM_HEURISTICS * sizeof(float) + 1);
+  d.y = malloc(num_records * sizeof(float) + 1);
+  if (d.x == NULL || d.y == NULL) {
+    fprintf(stderr, "%s: not enough memory for %zu positions\n", argv[0],
+            num_records);
+    free(d.x);
+    free(d.y);
+    free(records);
+    return 1;
+  }
+  #ifdef PARALLEL
+    cilk_for (size_t i = 0; i < num_records; i++) {
+      featurize(records, i, &d);
+    }
+  #else
+    for (size_t i = 0; i < num_records; i++) {
+      featurize(records, i, &d);
+    }
+  #endif
+  free(records);
+
+  // Drop the records that held no board
+  d.n = 0;
+  for (size_t i = 0; i < num_records; i++) {
+    if (d.y[i] < 0) {
+      continue;
+    }
+    memmove(&d.x[d.n * NUM_HEURISTICS], &d.x[i * NUM_HEURISTICS],
+            NUM_HEURISTICS * sizeof(float));
+    d.y[d.n++] = d.y[i];
+  }
+  if (d.n == 0) {
+    fprintf(stderr, "%s: no positions\n", argv[0]);
+    free(d.x);
+    free(d.y);
+    return 1;
+  }
+  if (d.n < num_records) {
+    fprintf(stderr, "info skipped %zu records that hold no board\n",
+            num_records - d.n);
+  }
+
+  double w[NUM_HEURISTICS];
+  for (int j = 0; j < NUM_HEURISTICS; j++) {
+    w[j] = *heuristic_weights[j];
+  }
+  double k = fit_k(&d, w);
+  double start_loss = loss(&d, w, k, NULL);
+  fprintf(stderr, "info tune positions %zu K %.1f loss %.6f\n", d.n, k,
+          start_loss);
+
+  double m[NUM_HEURISTICS] = {0};
+  double v[NUM_HEURISTICS] = {0};
+  for (int t = 1; t <= iterations; t++) {
+    double grad[NUM_HEURISTICS];
+    double l = loss(&d, w, k, grad);
+    double lr = LEARNING_RATE * (1 - (double)(t - 1) / iterations);
+    for (int j = 0; j < NUM_HEURISTICS; j++) {
+      if (j == PMAT) {
+        continue;
+      }
+      m[j] = BETA1 * m[j] + (1 - BETA1) * grad[j];
+      v[j] = BETA2 * v[j] + (1 - BETA2) * grad[j] * grad[j];
+      double m_hat = m[j] / (1 - pow(BETA1, t));
+      double v_hat = v[j] / (1 - pow(BETA2, t));
+      w[j] -= lr * m_hat / (sqrt(v_hat) + 1e-12);
+      w[j] = fmax(-MAX_WEIGHT, fmin(MAX_WEIGHT, w[j]));
+    }
+    if (t % 100 == 0 || t == iterations) {
+      fprintf(stderr, "info tune iteration %d loss %.6f\n", t, l);
+    }
+  }
+
+  int tuned[NUM_HEURISTICS];
+  for (int j = 0; j < NUM_HEURISTICS; j++) {
+    tuned[j] = (int)lround(w[j]);
+    w[j] = tuned[j];
+  }
+  printf("// Tuned on %zu positions (K %.1f): loss %.6f before, %.6f after\n",
+         d.n, k, start_loss, loss(&d, w, k, NULL));
+  print_weights(tuned);
+
+  free(d.x);
+  free(d.y);
+  return 0;
+}
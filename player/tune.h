@@ -0,0 +1,17 @@
+// Copyright (c) 2022 MIT License by 6.172 / 6.106 Staff
+
+// Texel tuning of the evaluator's weights, run as `leiserchess tune`.
+//
+// https://www.chessprogramming.org/Texel%27s_Tuning_Method
+
+#ifndef TUNE_H
+#define TUNE_H
+
+// leiserchess tune <dataset> [iterations]
+//
+// Fits the weights of the heuristics (options.h) to the outcomes of the
+// positions in dataset (dataset.h), starting from their current values, and
+// prints the result as lines of the iopts table.  Returns the exit status.
+int tune_main(int argc, char* argv[]);
+
+#endif  // TUNE_H
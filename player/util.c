@@ -97,3 +97,12 @@ uint64_t myrand() {
 
   return x + y + z1 + ((uint64_t)z2 << 32);  // Return 64-bit result
 }
+
+// splitmix64: the next number of the stream whose state is *state, for
+// callers that need a stream of their own, repeatable from its seed
+uint64_t splitmix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
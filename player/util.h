@@ -37,4 +37,5 @@
 void debug_log(int log_level, const char* str, ...);
 double milliseconds();
 uint64_t myrand();
+uint64_t splitmix64(uint64_t* state);
 #endif  // UTIL_H
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# ctypes wrapper around the batch API of libleiserchess.so (player/batch.h)
+# Build the library with `make lib` in player/ first
+import ctypes
+import os
+import sys
+
+DEFAULT_LIB = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "player", "libleiserchess.so")
+FEN_BUF = 256
+MOVE_BUF = 16
+
+class Batch:
+    def __init__(self, path=DEFAULT_LIB):
+        lib = ctypes.CDLL(path)
+        P = ctypes.c_void_p
+        I = ctypes.c_int
+        lib.lc_alloc_positions.restype = P
+        lib.lc_alloc_positions.argtypes = [I]
+        lib.lc_free_positions.argtypes = [P]
+        lib.lc_copy_position.argtypes = [P, I, P, I]
+        lib.lc_set_fen.argtypes = [P, I, ctypes.c_char_p]
+        lib.lc_get_fen.argtypes = [P, I, ctypes.c_char_p, I]
+        lib.lc_is_game_over.argtypes = [P, I]
+        lib.lc_generate.argtypes = [P, I, ctypes.POINTER(ctypes.c_uint16), ctypes.POINTER(I)]
+        lib.lc_make_moves.argtypes = [P, I, ctypes.POINTER(ctypes.c_uint16), ctypes.POINTER(I), P, ctypes.POINTER(ctypes.c_int8)]
+        lib.lc_move_to_str.argtypes = [ctypes.c_uint16, ctypes.c_char_p, I]
+        lib.lc_eval_features.argtypes = [P, I, ctypes.POINTER(ctypes.c_int32)]
+        lib.lc_init()
+        self.lib = lib
+        self.max_moves = lib.lc_max_moves()
+        self.num_heuristics = lib.lc_num_heuristics()
+
+    def move_str(self, mv):
+        buf = ctypes.create_string_buffer(MOVE_BUF)
+        self.lib.lc_move_to_str(mv, buf, MOVE_BUF)
+        return buf.value.decode()
+
+    def fen(self, ps, i):
+        buf = ctypes.create_string_buffer(FEN_BUF)
+        self.lib.lc_get_fen(ps, i, buf, FEN_BUF)
+        return buf.value.decode()
+
+    # Returns an array of positions set from fens (None is the starting position)
+    # Free it with free()
+    def positions(self, fens):
+        ps = self.lib.lc_alloc_positions(len(fens))
+        for i, fen in enumerate(fens):
+            if self.lib.lc_set_fen(ps, i, fen.encode() if fen else None) != 0:
+                self.free(ps)
+                raise ValueError(f"bad fen: {fen}")
+        return ps
+
+    def free(self, ps):
+        self.lib.lc_free_positions(ps)
+
+    def is_game_over(self, ps, i):
+        return bool(self.lib.lc_is_game_over(ps, i))
+
+    # Generates the moves of the n positions in ps and makes each of them
+    # Returns (moves, offsets, children, victims): the moves of ps[i] are
+    # moves[offsets[i]:offsets[i+1]] and children[j] is reached by moves[j]
+    # Free children with free()
+    def expand(self, ps, n):
+        moves = (ctypes.c_uint16 * (n * self.max_moves))()
+        offsets = (ctypes.c_int * (n + 1))()
+        total = self.lib.lc_generate(ps, n, moves, offsets)
+        children = self.lib.lc_alloc_positions(total)
+        victims = (ctypes.c_int8 * max(total, 1))()
+        self.lib.lc_make_moves(ps, n, moves, offsets, children, victims)
+        return moves[:total], offsets[:], children, victims[:total]
+
+    # Returns White's lead in each heuristic of each of the n positions in ps,
+    # unweighted, as a list of num_heuristics ints per position (see
+    # eval_features() in player/eval.h)
+    def features(self, ps, n):
+        out = (ctypes.c_int32 * (n * self.num_heuristics))()
+        self.lib.lc_eval_features(ps, n, out)
+        k = self.num_heuristics
+        return [out[i * k:(i + 1) * k] for i in range(n)]
+
+# Prints the number of moves and children of each FEN given on the command line
+if __name__ == "__main__":
+    b = Batch()
+    fens = sys.argv[1:] or [None]
+    ps = b.positions(fens)
+    moves, offsets, children, victims = b.expand(ps, len(fens))
+    for i in range(len(fens)):
+        print(b.fen(ps, i), offsets[i + 1] - offsets[i], "moves")
+    b.free(children)
+    b.free(ps)
@@ -35,6 +35,10 @@ class Engine:
             if cols[0]=="bestmove": break
         return output
 
+    def fen(self):
+        self.send_command(f"fen\n")
+        return self.proc.stdout.readline().strip()
+
     def status(self):
         self.send_command(f"status\n")
         line = self.proc.stdout.readline().strip()
@@ -54,6 +58,14 @@ class Engine:
         return weights
         
 
+    # White's lead in each heuristic, unweighted, in one line
+    def evalvec(self):
+        self.send_command(f"evalvec\n")
+        while True:
+            cols = self.proc.stdout.readline().split()
+            if cols and cols[0] == "evalvec":
+                return cols[1:]
+
     def make_move(self, move):
         self.send_command(f"move {move}\n")
         while True:
@@ -66,8 +78,8 @@ class Engine:
         self.proc.terminate()
 
 import numpy as np
-def writer(q):
-    with open("games_tuning_output.txt", 'a') as f:
+def writer(q, path):
+    with open(path, 'a') as f:
         print("Started writer")
         while True:
             m = q.get()
@@ -75,7 +87,7 @@ def writer(q):
                 break
             f.write(str(m) + "\n")
             f.flush()
-def worker(arg, q):
+def worker(arg, q, record_fen):
     try:
         eng_a = Engine("../player/leiserchess")
         eng_b = Engine("../player/leiserchess")
@@ -94,20 +106,22 @@ def worker(arg, q):
                 best_move = output[-1].split()[-1]
                 score = int(output[-2].split()[3])
                 moves.append(best_move)
-                eval_coefficients = list(map(int, engs[cur_turn%2].eval()))
+                if record_fen:
+                    fen = engs[cur_turn%2].fen()
+                else:
+                    eval_coefficients = list(map(int, engs[cur_turn%2].evalvec()))
                 num_victims = engs[cur_turn%2].make_move(best_move)
                 if num_victims == 0 and abs(score)<3000: # quiescent position and not mated
-                    positions.append(np.array(eval_coefficients))
+                    positions.append(fen if record_fen else np.array(eval_coefficients))
                 status = engs[cur_turn%2].status()
                 if "mate" in status or "draw" in status:
                     if "mate" in status:
-                        if cur_turn%2:
-                            result = 1
-                        else:
-                            result = 0
+                        result = 1 if "white wins" in status else 0
                     else:
                         result = 0.5
-                    if len(positions)>0:
+                    if record_fen:
+                        positions = [f"{fen},{result}" for fen in positions]
+                    elif len(positions)>0:
                         positions = np.stack(positions)
                         positions = np.hstack((positions, result*np.ones((positions.shape[0], 1))))
                         print(positions, result)
@@ -115,7 +129,7 @@ def worker(arg, q):
                 cur_turn += 1
 
             for row in positions:
-                q.put(",".join(map(str, list(row))))
+                q.put(row if record_fen else ",".join(map(str, list(row))))
         raise ValueError
     except:
         raise AssertionError
@@ -125,20 +139,23 @@ def worker(arg, q):
         except:
             pass
 
-if len(sys.argv) != 2:
-    print("Usage: python3 datagen.py num_workers")
+if len(sys.argv) not in (2, 3) or (len(sys.argv) == 3 and sys.argv[2] != "--fen"):
+    print("Usage: python3 datagen.py num_workers [--fen]")
     print("    num_workers: number of concurrent worker threads running games")
+    print("    --fen: record positions as FENs, for project4_training_script.py --nnue")
     exit()
 num_threads = int(sys.argv[1])
+record_fen = len(sys.argv) == 3
+output = "games_nnue_output.txt" if record_fen else "games_tuning_output.txt"
 
 manager = mp.Manager()
 q = manager.Queue()
 p = mp.Pool(num_threads+1)
 
-w = p.apply_async(writer, (q,))
+w = p.apply_async(writer, (q, output))
 jobs = []
 for i in range(num_threads):
-    job = p.apply_async(worker, (i, q))
+    job = p.apply_async(worker, (i, q, record_fen))
     jobs.append(job)
 
 for job in jobs:
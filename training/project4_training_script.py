@@ -1,3 +1,18 @@
+# Trains the evaluator weights
+#
+# Usage: python3 project4_training_script.py
+#          fits the iopts weights of eval() to games_tuning_output.txt and
+#          prints them
+#        python3 project4_training_script.py --nnue [data] [weights]
+#          trains the network evaluator of player/nnue.c and writes its
+#          weights file
+#   data:    csv file with no header, one "<fen>,<game outcome>" row per
+#            position, the outcome for White (0, 0.5 or 1); written by
+#            `python3 datagen.py num_workers --fen`
+#   weights: file to write, leiserchess.nnue by default
+import struct
+import sys
+
 from tqdm import tqdm
 import torch
 import torch.nn as nn
@@ -16,6 +31,11 @@ class PositionDataset(Dataset):
             file, header=None).astype(np.float32).values)
         print("Done reading")
 
+        # Rows of White's scores then Black's, from older datagen runs, are
+        # turned into White's lead, which is what evalvec writes
+        if self.data.shape[1] == 21:
+            self.data = torch.cat((self.data[:, :10]-self.data[:, 10:20], self.data[:, 20:]), dim=1)
+
         # Scale columns in the same way that eval() does so that coefficients have the same order of magnitude
         self.data[:, 1] /= 10000
         self.data[:, 2] /= 10000
@@ -23,13 +43,6 @@ class PositionDataset(Dataset):
         self.data[:, 4] /= 10000
         self.data[:, 8] /= 10000
         self.data[:, 9] /= 10000
-        
-        self.data[:, 1+10] /= 10000
-        self.data[:, 2+10] /= 10000
-        self.data[:, 3+10] /= 10000
-        self.data[:, 4+10] /= 10000
-        self.data[:, 8+10] /= 10000
-        self.data[:, 9+10] /= 10000
     
     def __len__(self):
         return len(self.data)
@@ -44,63 +57,254 @@ class LogisticModel(nn.Module):
         self.linear_middlegame = nn.Linear(10, 1, bias=False)
 
     def forward(self, x):
-        score = self.linear_middlegame(x[:, :10]-x[:, 10:20])[:, 0]
+        score = self.linear_middlegame(x)[:, 0]
         return score
 
 
 TRAIN_SPLIT = 0.8
 BS = 16384
 LR = 0.001
-# games_output should be csv file with no header, 21 values per row
-# <10 eval scores for white>,<10 eval scores for black>,<game outcome (0, 0.5, or 1)>
-dataset = PositionDataset("./games_tuning_output.txt")
-train_size = int(TRAIN_SPLIT*len(dataset))
-test_size = len(dataset)-train_size
-train_dataset, test_dataset = torch.utils.data.random_split(
-    dataset, [train_size, test_size])
-train_loader, test_loader = DataLoader(train_dataset, batch_size=BS, shuffle=True, num_workers=8), DataLoader(
-    test_dataset, batch_size=BS, shuffle=True, num_workers=8)
-model = LogisticModel()
-if CUDA:
-    model = model.to(device)
-criterion = nn.BCEWithLogitsLoss()
-optim = torch.optim.Adam(model.parameters(), lr=LR)
-# usually 20-30 epochs is sufficient
-# train/test loss should be around 4e-5 (or lower)
-for epoch in range(30):
-    tot_train_loss = 0
-    tot_test_loss = 0
-    tot_train, tot_test = 0, 0
-    for i, data in enumerate(tqdm(train_loader)):
-        if CUDA:
-            data = data.to(device)
-        tot_train += len(data)
-        x = data[:, :20]
-        y = data[:, -1]
-        optim.zero_grad()
-        out = model(x).squeeze(-1)
-        loss = criterion(out, y)
-        # L2 regularization
-        loss += torch.sum(torch.square(model.linear_middlegame.weight))*3e-6
-        loss.backward()
-        optim.step()
-        tot_train_loss += loss.item()
-        print(f"Epoch {epoch}: train loss {tot_train_loss/tot_train}")
-    with torch.no_grad():
-        for i, data in enumerate(test_loader):
+
+
+def train_linear():
+    # games_output should be csv file with no header, 11 values per row
+    # <White's lead in the 10 eval scores>,<game outcome (0, 0.5, or 1)>
+    # (21 values per row, the scores of White then Black, are read as well)
+    dataset = PositionDataset("./games_tuning_output.txt")
+    train_size = int(TRAIN_SPLIT*len(dataset))
+    test_size = len(dataset)-train_size
+    train_dataset, test_dataset = torch.utils.data.random_split(
+        dataset, [train_size, test_size])
+    train_loader, test_loader = DataLoader(train_dataset, batch_size=BS, shuffle=True, num_workers=8), DataLoader(
+        test_dataset, batch_size=BS, shuffle=True, num_workers=8)
+    model = LogisticModel()
+    if CUDA:
+        model = model.to(device)
+    criterion = nn.BCEWithLogitsLoss()
+    optim = torch.optim.Adam(model.parameters(), lr=LR)
+    # usually 20-30 epochs is sufficient
+    # train/test loss should be around 4e-5 (or lower)
+    for epoch in range(30):
+        tot_train_loss = 0
+        tot_test_loss = 0
+        tot_train, tot_test = 0, 0
+        for i, data in enumerate(tqdm(train_loader)):
             if CUDA:
                 data = data.to(device)
-            tot_test += len(data)
-            x = data[:, :20]
+            tot_train += len(data)
+            x = data[:, :10]
             y = data[:, -1]
+            optim.zero_grad()
             out = model(x).squeeze(-1)
             loss = criterion(out, y)
-            tot_test_loss += loss.item()
-    print(f"Epoch {epoch}: test loss {tot_test_loss/tot_test}")
-    torch.set_printoptions(sci_mode=False)
-    
-    # in eval() PMAT is implicitly 1 so we scale everything to make this true
-    scaled1 = (model.linear_middlegame.weight)[
-        0]/model.linear_middlegame.weight[0, 7]
-    # these should be multiplied by P_EV_VAL when copied into the iopts array
-    print(scaled1)
+            # L2 regularization
+            loss += torch.sum(torch.square(model.linear_middlegame.weight))*3e-6
+            loss.backward()
+            optim.step()
+            tot_train_loss += loss.item()
+            print(f"Epoch {epoch}: train loss {tot_train_loss/tot_train}")
+        with torch.no_grad():
+            for i, data in enumerate(test_loader):
+                if CUDA:
+                    data = data.to(device)
+                tot_test += len(data)
+                x = data[:, :10]
+                y = data[:, -1]
+                out = model(x).squeeze(-1)
+                loss = criterion(out, y)
+                tot_test_loss += loss.item()
+        print(f"Epoch {epoch}: test loss {tot_test_loss/tot_test}")
+        torch.set_printoptions(sci_mode=False)
+
+        # in eval() PMAT is implicitly 1 so we scale everything to make this true
+        scaled1 = (model.linear_middlegame.weight)[
+            0]/model.linear_middlegame.weight[0, 7]
+        # these should be multiplied by P_EV_VAL when copied into the iopts array
+        print(scaled1)
+
+
+# Must match player/nnue.h and move_gen.h
+BOARD_WIDTH = 8
+BOARD_SIZE = BOARD_WIDTH * BOARD_WIDTH
+KINDS = 16
+FEATURES = BOARD_SIZE * KINDS
+HIDDEN = 64
+QA = 127
+QB = 64
+VERSION = 1
+# Centipawns per unit of the network's output, which is trained as the logit
+# of the outcome for the side to move
+SCALE = 173
+
+MONARCH_ORI = {"NN": 0, "EE": 1, "SS": 2, "WW": 3}
+PAWN_ORI = {"NW": 0, "NE": 1, "SE": 2, "SW": 3}
+
+
+# Parses the board and side to move of a FEN into (side, [(sq, color, is
+# monarch, ori)]), with squares numbered as in move_gen.h
+def parse_fen(fen):
+    board, side = fen.split()[:2]
+    pieces = []
+    for i, row in enumerate(board.split("/")):
+        r = BOARD_WIDTH - 1 - i
+        f = 0
+        j = 0
+        while j < len(row):
+            if row[j].isdigit():
+                k = j
+                while k < len(row) and row[k].isdigit():
+                    k += 1
+                f += int(row[j:k])
+                j = k
+                continue
+            code = row[j:j + 2]
+            color = 0 if code.isupper() else 1
+            code = code.upper()
+            if code in MONARCH_ORI:
+                pieces.append((f * BOARD_WIDTH + r, color, 1, MONARCH_ORI[code]))
+            else:
+                pieces.append((f * BOARD_WIDTH + r, color, 0, PAWN_ORI[code]))
+            f += 1
+            j += 2
+    return (0 if side == "W" else 1), pieces
+
+
+# Active features of each half, as feature() in nnue.c numbers them: Black
+# sees the board turned around, its pieces as its own
+def features(pieces):
+    halves = ([], [])
+    for persp in (0, 1):
+        for sq, color, monarch, ori in pieces:
+            if persp == 1:
+                sq = BOARD_SIZE - 1 - sq
+                color ^= 1
+                ori ^= 2
+            halves[persp].append(sq * KINDS + (color << 3 | monarch << 2 | ori))
+    return halves
+
+
+class FenDataset(Dataset):
+    def __init__(self, file):
+        print("Reading dataset")
+        self.data = []
+        with open(file) as f:
+            for line in f:
+                fen, result = line.rsplit(",", 1)
+                side, pieces = parse_fen(fen)
+                halves = features(pieces)
+                result = float(result)
+                # the outcome, and the halves, for the side to move first
+                if side == 1:
+                    result = 1 - result
+                self.data.append((halves[side], halves[side ^ 1], result))
+        print("Done reading")
+
+    def __len__(self):
+        return len(self.data)
+
+    def __getitem__(self, idx):
+        return self.data[idx]
+
+
+def collate(batch):
+    us = torch.zeros(len(batch), FEATURES)
+    them = torch.zeros(len(batch), FEATURES)
+    y = torch.zeros(len(batch))
+    for i, (f_us, f_them, result) in enumerate(batch):
+        us[i, f_us] = 1
+        them[i, f_them] = 1
+        y[i] = result
+    return us, them, y
+
+
+class NnueModel(nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.ft = nn.Linear(FEATURES, HIDDEN)
+        self.out = nn.Linear(2 * HIDDEN, 1)
+
+    def forward(self, us, them):
+        h = torch.cat((self.ft(us), self.ft(them)), dim=1)
+        # clipped ReLU, as in clipped_dot()
+        return self.out(torch.clamp(h, 0, 1))[:, 0]
+
+    # Keeps the weights in the range their quantized forms can hold: the
+    # output weights must fit in an int8 and the first layer's sums in an
+    # int16 with room for every piece on the board
+    def clip(self):
+        with torch.no_grad():
+            self.ft.weight.clamp_(-2, 2)
+            self.ft.bias.clamp_(-2, 2)
+            self.out.weight.clamp_(-127 / QB, 127 / QB)
+
+
+def write_weights(path, ft_bias, ft_weights, out_weights, out_bias):
+    with open(path, "wb") as f:
+        f.write(b"LCNN")
+        f.write(struct.pack("<IIIi", VERSION, FEATURES, HIDDEN, SCALE))
+        f.write(struct.pack(f"<{HIDDEN}h", *ft_bias))
+        for row in ft_weights:
+            f.write(struct.pack(f"<{HIDDEN}h", *row))
+        f.write(struct.pack(f"<{2 * HIDDEN}b", *out_weights))
+        f.write(struct.pack("<i", out_bias))
+
+
+def quantize(model):
+    def q(t, scale, lo, hi):
+        return [min(hi, max(lo, round(v * scale))) for v in t.tolist()]
+    # nn.Linear keeps its weights as [outputs][inputs]; the file wants a row
+    # of the first layer's outputs per feature
+    ft_weights = [q(row, QA, -32767, 32767) for row in model.ft.weight.t()]
+    ft_bias = q(model.ft.bias, QA, -32767, 32767)
+    out_weights = q(model.out.weight[0], QB, -127, 127)
+    out_bias = round(model.out.bias.item() * QA * QB)
+    return ft_bias, ft_weights, out_weights, out_bias
+
+
+def train_nnue(data_file, weights_file):
+    dataset = FenDataset(data_file)
+    train_size = int(TRAIN_SPLIT*len(dataset))
+    test_size = len(dataset)-train_size
+    train_dataset, test_dataset = torch.utils.data.random_split(
+        dataset, [train_size, test_size])
+    train_loader = DataLoader(train_dataset, batch_size=BS, shuffle=True,
+                              num_workers=8, collate_fn=collate)
+    test_loader = DataLoader(test_dataset, batch_size=BS, shuffle=True,
+                             num_workers=8, collate_fn=collate)
+    model = NnueModel()
+    if CUDA:
+        model = model.to(device)
+    criterion = nn.BCEWithLogitsLoss()
+    optim = torch.optim.Adam(model.parameters(), lr=LR)
+    for epoch in range(30):
+        tot_train_loss = 0
+        tot_test_loss = 0
+        tot_train, tot_test = 0, 0
+        for us, them, y in tqdm(train_loader):
+            if CUDA:
+                us, them, y = us.to(device), them.to(device), y.to(device)
+            tot_train += len(y)
+            optim.zero_grad()
+            loss = criterion(model(us, them), y)
+            loss.backward()
+            optim.step()
+            model.clip()
+            tot_train_loss += loss.item() * len(y)
+        with torch.no_grad():
+            for us, them, y in test_loader:
+                if CUDA:
+                    us, them, y = us.to(device), them.to(device), y.to(device)
+                tot_test += len(y)
+                tot_test_loss += criterion(model(us, them), y).item() * len(y)
+        print(f"Epoch {epoch}: train loss {tot_train_loss/tot_train} "
+              f"test loss {tot_test_loss/tot_test}")
+
+    write_weights(weights_file, *quantize(model.cpu()))
+    print(f"Wrote {weights_file}")
+
+
+if len(sys.argv) > 1 and sys.argv[1] == "--nnue":
+    train_nnue(sys.argv[2] if len(sys.argv) > 2 else "./games_nnue_output.txt",
+               sys.argv[3] if len(sys.argv) > 3 else "leiserchess.nnue")
+else:
+    train_linear()